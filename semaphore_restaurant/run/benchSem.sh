@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# side by side benchmark of the semaphore backends (built with make bench)
+
+n=${1:-100000}
+
+for b in sysv futex posix
+do
+     ./benchSem_$b $n
+done
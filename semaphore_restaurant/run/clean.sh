@@ -7,3 +7,15 @@ rm -f core
 ipcrm -S 0x6106b0f5
 ipcrm -M 0x6106b0f5
 
+# other sets a large semaphore set is split into: key with the most significant byte xored with 1, 2, ...
+for k in $(seq 1 255); do ipcrm -S $(printf "0x%08x" $((0x6106b0f5 ^ (k << 24)))) 2>/dev/null; done
+
+# semaphores of the futex backend (make futex): key ^ 0x40000000
+ipcrm -M 0x2106b0f5 2>/dev/null
+
+# semaphores of the POSIX backend (make posix): key ^ 0x20000000
+ipcrm -M 0x4106b0f5 2>/dev/null
+
+
+# shared region of the POSIX shared memory backend (make pshm)
+rm -f /dev/shm/restaurant_6106b0f5 /dev/hugepages/restaurant_6106b0f5
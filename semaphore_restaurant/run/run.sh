@@ -11,8 +11,24 @@ if ! [ $n -gt 0 ] 2>/dev/null; then
     exit 1
 fi
 
+# seconds after which a run is considered stalled, killed and skipped
+deadline=10
+stalled=0
+
 for i in $(seq 1 $n)
 do
      echo -e "\n\e[34;1mRun n.º $i\e[0m"
-     ./probSemSharedMemRestaurant
+     ./probSemSharedMemRestaurant -d -w $deadline | ./loganalyze -q
+     status=("${PIPESTATUS[@]}")
+     if [ ${status[0]} -ne 0 ]; then
+         echo "Run n.º $i stalled or failed. Skipping."
+         stalled=$((stalled + 1))
+     elif [ ${status[1]} -ne 0 ]; then
+         echo "Protocol invariant violated in run n.º $i. Aborting."
+         exit 1
+     fi
 done
+
+if [ $stalled -gt 0 ]; then
+    echo "$stalled of $n runs stalled or failed."
+fi
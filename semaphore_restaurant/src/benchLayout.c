@@ -0,0 +1,176 @@
+/**
+ *  \file benchLayout.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Benchmark of the layout of the shared region: false sharing between the processes.
+ *
+ *  NPROCS processes run the accesses the entities make outside the critical region, on fields each of them
+ *  owns or only reads:
+ *    \li all of them read the id of the mutex (as every semaphore operation does) and write their own
+ *        watchdog slot twice (as every traced <em>down</em> does)
+ *    \li the first three post requests on a channel of their own (receptionist, waiter, chef order)
+ *    \li the last one reads the configuration (number of groups, start times).
+ *
+ *  The same loop runs on two layouts: the packed one the shared region used to have (the fields side by side,
+ *  <tt>PACKED_DATA</tt> below) and <tt>SHARED_DATA</tt> as it is now. The time per iteration is printed for
+ *  both; on a single processor host, there is no false sharing to remove and both take the same time.
+ *
+ *  Upon execution, one optional parameter is accepted:
+ *    \li number of iterations of each process (default 10000000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "sharedDataSync.h"
+
+/** \brief number of processes */
+#define  NPROCS            4
+
+/** \brief number of groups of the configuration */
+#define  NGROUPS           16
+
+/**
+ *  \brief Definition of the fields of the benchmark, laid out as the shared region used to be.
+ */
+typedef struct {
+    /** \brief number of groups */
+    int nGroups;
+    /** \brief estimated start time of groups */
+    int startTime[NGROUPS];
+    /** \brief flag of food request from waiter to chef */
+    int foodOrder;
+    /** \brief used by groups to store request to receptionist */
+    request receptionistRequest;
+    /** \brief used by groups and chef to store request to waiter */
+    request waiterRequest;
+    /** \brief identification of critical region protection semaphore */
+    unsigned int mutex;
+    /** \brief watchdog slot of each process */
+    unsigned int blockedOn[NPROCS];
+} PACKED_DATA;
+
+/**
+ *  \brief Definition of the locations the processes access in one layout.
+ */
+typedef struct {
+    /** \brief id of the mutex */
+    volatile unsigned int *mutex;
+    /** \brief watchdog slot of each process */
+    volatile unsigned int *slot[NPROCS];
+    /** \brief request channel of each of the first NPROCS-1 processes */
+    volatile int *chan[NPROCS-1];
+    /** \brief number of groups */
+    volatile int *nGroups;
+    /** \brief start times */
+    volatile int *startTime;
+} LAYOUT;
+
+/** \brief current value of the monotonic clock in nanoseconds */
+static long long nowNs (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** \brief accesses of process p in n iterations */
+static void work (LAYOUT *l, int p, long n)
+{
+    unsigned int id;
+    long i, sum = 0;
+
+    for (i = 0; i < n; i++) {
+        id = *l->mutex;
+        *l->slot[p] = id;
+        *l->slot[p] = 0;
+        if (p < NPROCS - 1) {
+            *l->chan[p] = (int) i;
+        }
+        else sum += *l->nGroups + l->startTime[i % NGROUPS];
+    }
+    if (sum == -1) {
+        printf ("\n");                                                              /* keeps sum alive */
+    }
+}
+
+/** \brief runs the NPROCS processes on a layout; returns the elapsed time in ns */
+static long long run (LAYOUT *l, long n)
+{
+    long long t0;
+    int p;
+
+    fflush (stdout);
+    t0 = nowNs ();
+    for (p = 0; p < NPROCS; p++) {
+        if (fork () == 0) {
+            work (l, p, n);
+            exit (EXIT_SUCCESS);
+        }
+    }
+    while (wait (NULL) != -1);
+    return nowNs () - t0;
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    PACKED_DATA *pk;                                                                            /* packed layout */
+    SHARED_DATA *sh;                                                                           /* current layout */
+    LAYOUT lPacked, lShared;
+    long long tPacked, tShared;
+    long n = 10000000;                                                                      /* number of iterations */
+    int p;
+
+    if (argc > 1) n = atol (argv[1]);
+    if (n <= 0) {
+        fprintf (stderr, "USAGE: %s [number-of-iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pk = mmap (NULL, sizeof (PACKED_DATA), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    sh = mmap (NULL, sharedDataSize (NGROUPS, NUMTABLES, NUMWAITERS, false), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if ((pk == MAP_FAILED) || (sh == MAP_FAILED)) {
+        perror ("error on mapping the shared regions");
+        return EXIT_FAILURE;
+    }
+    setSharedData (sh, NGROUPS, NUMTABLES, NUMWAITERS, NUMCHEFS, false);
+
+    lPacked.mutex = &pk->mutex;
+    lShared.mutex = &sh->mutex;
+    for (p = 0; p < NPROCS; p++) {
+        lPacked.slot[p] = &pk->blockedOn[p];
+    }
+    lShared.slot[0] = &sh->receptionistBlockedOn.sindex;
+    lShared.slot[1] = &sh->waiterBlockedOn[0].sindex;
+    lShared.slot[2] = &sh->chefBlockedOn[0].sindex;
+    lShared.slot[3] = &groupBlockedOn (sh)[0].sindex;
+    lPacked.chan[0] = &pk->receptionistRequest.reqType;
+    lPacked.chan[1] = &pk->waiterRequest.reqType;
+    lPacked.chan[2] = &pk->foodOrder;
+    lShared.chan[0] = &sh->fSt.receptionistRequest.reqType;
+    lShared.chan[1] = (volatile int *) &sh->waiterQueue[0].head;
+    lShared.chan[2] = (volatile int *) &sh->chefQueue.head;
+    lPacked.nGroups = &pk->nGroups;
+    lShared.nGroups = &sh->fSt.nGroups;
+    lPacked.startTime = pk->startTime;
+    lShared.startTime = startTime (&sh->fSt);
+
+    tPacked = run (&lPacked, n);
+    tShared = run (&lShared, n);
+
+    printf ("x%d processes   packed layout %6.2f ns/iteration   SHARED_DATA %6.2f ns/iteration   (%ld cpus)\n",
+            NPROCS, (double) tPacked / n, (double) tShared / n, sysconf (_SC_NPROCESSORS_ONLN));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/**
+ *  \file benchLog.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Benchmark of the time the critical region is held while the internal state is logged.
+ *
+ *  Each iteration enters a critical region protected by a semaphore, saves the state, and leaves the critical region.
+ *  The time elapsed between the end of the <em>down</em> and the start of the <em>up</em> (mutex hold time) is
+ *  measured:
+ *    \li without a logging session (the log file is opened and closed for every record)
+ *    \li with a logging session (the log file is kept open)
+ *    \li with a logging session in binary format
+ *    \li with a snapshot taken inside the critical region and written after leaving it
+ *    \li with records handed to a logger process through the log ring buffer.
+ *
+ *  Upon execution, three optional parameters are accepted:
+ *    \li number of records to log (default 10000)
+ *    \li name of the logging file (default benchLog.txt)
+ *    \li number of groups of the state (default 16).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "logging.h"
+#include "semaphore.h"
+
+/** \brief semaphore that plays the role of the mutex */
+#define  BENCHMUTEX        1
+
+/** \brief default number of groups */
+#define  BENCHGROUPS       16
+
+/** \brief current value of the monotonic clock in nanoseconds */
+static long long nowNs (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  \brief logs <tt>n</tt> records inside the critical region and prints the mutex hold time statistics.
+ */
+static void run (char *label, int semgid, char nFic[], FULL_STAT *p_fSt, int n, bool snapshot)
+{
+    LOG_RECORD *snap = newLogRecord (p_fSt->nGroups, p_fSt->nWaiters, p_fSt->nChefs);   /* logged state */
+    long long t0, dt, total = 0, max = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (semDown (semgid, BENCHMUTEX) == -1) {
+            perror ("error on the down operation for semaphore access (BENCH)");
+            exit (EXIT_FAILURE);
+        }
+        t0 = nowNs ();
+
+        groupStat (p_fSt)[i % p_fSt->nGroups] = 1 + i % LEAVING;
+        if (snapshot) {
+            snapshotState (snap, p_fSt);
+        }
+        else saveState (nFic, p_fSt);
+
+        dt = nowNs () - t0;
+        if (semUp (semgid, BENCHMUTEX) == -1) {
+            perror ("error on the up operation for semaphore access (BENCH)");
+            exit (EXIT_FAILURE);
+        }
+        if (snapshot) {
+            writeSnapshot (nFic, snap);
+        }
+        total += dt;
+        if (dt > max) max = dt;
+    }
+    printf ("%-12s %8d records   mean hold %9.3f us   max hold %9.3f us\n",
+            label, n, total / (1000.0 * n), max / 1000.0);
+    free (snap);
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    char nFic[51] = "benchLog.txt";                                                         /* name of logging file */
+    FULL_STAT *fSt;                                                                 /* state written to the log file */
+    LOG_CTL *ctl;                                                                 /* shared logging control data */
+    int pid;                                                                          /* logger process identifier */
+    int n = 10000,                                                                      /* number of records per run */
+        nGroups = BENCHGROUPS,                                                                    /* number of groups */
+        semgid,                                                                     /* semaphore set access identifier */
+        g;
+
+    if (argc > 1) n = atoi (argv[1]);
+    if (argc > 2) strncpy (nFic, argv[2], sizeof (nFic) - 1);
+    if (argc > 3) nGroups = atoi (argv[3]);
+    if ((n <= 0) || (nGroups <= 0)) {
+        fprintf (stderr, "USAGE: %s [number-of-records [log-file [number-of-groups]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* the per-record open messages of the logging module are not relevant here */
+    freopen ("/dev/null", "w", stderr);
+
+    if ((fSt = aligned_alloc (CACHE_LINE, sizeof (FULL_STAT) + fullStatDataSize (nGroups))) == NULL) {
+        perror ("error on allocating the state");
+        return EXIT_FAILURE;
+    }
+    memset (fSt, 0, sizeof (FULL_STAT) + fullStatDataSize (nGroups));
+    setFullStatData (fSt, fSt + 1, nGroups);
+    fSt->nTables = NUMTABLES;
+    fSt->nWaiters = NUMWAITERS;
+    fSt->nChefs = NUMCHEFS;
+    for (g = 0; g < nGroups; g++) {
+        groupStat (fSt)[g] = GOTOREST;
+        assignedTable (fSt)[g] = g % (NUMTABLES + 1) - 1;
+    }
+
+    if ((semgid = semCreate (IPC_PRIVATE, 1)) == -1) {
+        perror ("error on creating the semaphore set");
+        return EXIT_FAILURE;
+    }
+    if (semUp (semgid, BENCHMUTEX) == -1) {
+        perror ("error on executing the up operation for semaphore access");
+        return EXIT_FAILURE;
+    }
+
+    createLog (nFic, fSt);
+    run ("no session", semgid, nFic, fSt, n, false);
+
+    createLog (nFic, fSt);
+    openLogSession (nFic, NULL, NULL);
+    run ("session", semgid, nFic, fSt, n, false);
+    closeLogSession ();
+
+    ctl = mmap (NULL, sizeof (LOG_CTL) + logCtlDataSize (nGroups, true), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ctl == MAP_FAILED) {
+        perror ("error on mapping the logging control data");
+        return EXIT_FAILURE;
+    }
+    setLogCtlData (ctl, ctl + 1, nGroups, true);
+    ctl->format = LOG_BINARY;
+    openLogSession (nFic, ctl, NULL);
+    createLog (nFic, fSt);
+    run ("binary", semgid, nFic, fSt, n, false);
+    closeLogSession ();
+
+    ctl->format = LOG_TEXT;
+    openLogSession (nFic, ctl, NULL);
+    createLog (nFic, fSt);
+    run ("snapshot", semgid, nFic, fSt, n, true);
+    closeLogSession ();
+
+    ctl->format = LOG_TEXT;
+    createLogRing (ctl, LOG_BLOCK);
+    openLogSession (nFic, ctl, NULL);
+    createLog (nFic, fSt);
+    fflush (stdout);
+    if ((pid = fork ()) == 0) {
+        drainLogRing (nFic, ctl);
+        exit (EXIT_SUCCESS);
+    }
+    run ("ring", semgid, nFic, fSt, n, false);
+    closeLogRing (ctl);
+    waitpid (pid, NULL, 0);
+    closeLogSession ();
+
+    semDestroy (semgid);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/**
+ *  \file benchSem.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Benchmark of the semaphore backend the program is linked with (semaphore.c, semaphoreFutex.c or
+ *  semaphorePosix.c; <tt>make bench</tt> builds one binary for each, <tt>benchSem_sysv</tt>,
+ *  <tt>benchSem_futex</tt> and <tt>benchSem_posix</tt>, and <tt>run/benchSem.sh</tt> runs them side by side).
+ *
+ *  Three patterns of the restaurant workload are measured:
+ *    \li uncontended <em>down</em> / <em>up</em> pairs on a mutex (ns per pair)
+ *    \li ping-pong between two processes, each one waking the other, as the waiter and the chef do (us per
+ *        round trip)
+ *    \li a mutex contended by NPROCS processes, each one updating shared data in the critical region (ns per
+ *        critical region), first with <tt>semDown</tt> and then with <tt>semDownAdaptive</tt>.
+ *
+ *  Upon execution, one optional parameter is accepted:
+ *    \li number of iterations of each pattern (default 100000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "semaphore.h"
+
+/** \brief semaphore that plays the role of the mutex */
+#define  BENCHMUTEX        1
+/** \brief semaphore the first process of the ping-pong waits on */
+#define  PING              2
+/** \brief semaphore the second process of the ping-pong waits on */
+#define  PONG              3
+/** \brief number of semaphores of the set */
+#define  SEM_NU            3
+
+/** \brief number of processes contending for the mutex */
+#define  NPROCS            4
+
+/** \brief current value of the monotonic clock in nanoseconds */
+static long long nowNs (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/** \brief down on a semaphore of the benchmark, aborting on error */
+static void down (int semgid, unsigned int sindex)
+{
+    if (semDown (semgid, sindex) == -1) {
+        perror ("error on the down operation for semaphore access (BENCH)");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/** \brief adaptive down on a semaphore of the benchmark, aborting on error */
+static void downAdaptive (int semgid, unsigned int sindex)
+{
+    if (semDownAdaptive (semgid, sindex) == -1) {
+        perror ("error on the down operation for semaphore access (BENCH)");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/** \brief up on a semaphore of the benchmark, aborting on error */
+static void up (int semgid, unsigned int sindex)
+{
+    if (semUp (semgid, sindex) == -1) {
+        perror ("error on the up operation for semaphore access (BENCH)");
+        exit (EXIT_FAILURE);
+    }
+}
+
+/** \brief waits for all the child processes */
+static void waitChildren (void)
+{
+    while (wait (NULL) != -1);
+}
+
+/** \brief mutex contended by NPROCS processes, n critical regions in all; returns the elapsed time in ns */
+static long long contend (int semgid, long *counter, int n, bool adaptive)
+{
+    long long t0;
+    int i, p;
+
+    *counter = 0;
+    t0 = nowNs ();
+    for (p = 0; p < NPROCS; p++) {
+        if (fork () == 0) {
+            for (i = 0; i < n / NPROCS; i++) {
+                if (adaptive) downAdaptive (semgid, BENCHMUTEX);
+                    else down (semgid, BENCHMUTEX);
+                *counter += 1;
+                up (semgid, BENCHMUTEX);
+            }
+            exit (EXIT_SUCCESS);
+        }
+    }
+    waitChildren ();
+    t0 = nowNs () - t0;
+    if (*counter != (long) (n / NPROCS) * NPROCS) {
+        fprintf (stderr, "mutual exclusion failed: counter %ld\n", *counter);
+        exit (EXIT_FAILURE);
+    }
+    return t0;
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    char *name;                                                                                    /* backend name */
+    long *counter;                                                                  /* data shared by the processes */
+    long long t0, tUncont, tPing, tMutex, tAdaptive;
+    int n = 100000,                                                                           /* number of iterations */
+        semgid,                                                                     /* semaphore set access identifier */
+        i;
+
+    if (argc > 1) n = atoi (argv[1]);
+    if (n <= 0) {
+        fprintf (stderr, "USAGE: %s [number-of-iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    name = ((name = strrchr (argv[0], '_')) != NULL) ? name + 1 : argv[0];
+
+    if ((semgid = semCreate (IPC_PRIVATE, SEM_NU)) == -1) {
+        perror ("error on creating the semaphore set");
+        return EXIT_FAILURE;
+    }
+    counter = mmap (NULL, sizeof (long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counter == MAP_FAILED) {
+        perror ("error on mapping the shared counter");
+        return EXIT_FAILURE;
+    }
+    up (semgid, BENCHMUTEX);
+
+    /* uncontended down / up pairs */
+    t0 = nowNs ();
+    for (i = 0; i < n; i++) {
+        down (semgid, BENCHMUTEX);
+        up (semgid, BENCHMUTEX);
+    }
+    tUncont = nowNs () - t0;
+
+    /* ping-pong between two processes */
+    fflush (stdout);
+    t0 = nowNs ();
+    if (fork () == 0) {
+        for (i = 0; i < n; i++) {
+            down (semgid, PONG);
+            up (semgid, PING);
+        }
+        exit (EXIT_SUCCESS);
+    }
+    for (i = 0; i < n; i++) {
+        up (semgid, PONG);
+        down (semgid, PING);
+    }
+    waitChildren ();
+    tPing = nowNs () - t0;
+
+    /* mutex contended by NPROCS processes */
+    tMutex = contend (semgid, counter, n, false);
+    tAdaptive = contend (semgid, counter, n, true);
+
+    printf ("%-6s uncontended %8.1f ns/pair   ping-pong %8.2f us/round trip   mutex x%d %8.1f ns/region"
+            "   adaptive x%d %8.1f ns/region\n",
+            name, (double) tUncont / n, tPing / (1000.0 * n), NPROCS, (double) tMutex / ((n / NPROCS) * NPROCS),
+            NPROCS, (double) tAdaptive / ((n / NPROCS) * NPROCS));
+
+    semDestroy (semgid);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/**
+ *  \file loganalyze.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Single pass analyzer of log files (text, binary or delta).
+ *
+ *  The records are read as a stream, put back in sequence order (records written straight away by each process
+ *  may reach the file out of order), and
+ *    \li printed in the filtered layout of <tt>filter_log.awk</tt> (unless option <tt>-q</tt> is given)
+ *    \li checked against the protocol invariants: no table is assigned to two groups, every group goes
+ *        through the states GOTOREST ... LEAVING in order, groupsWaiting is never negative; violations are
+ *        reported on stderr and make the exit status EXIT_FAILURE
+ *    \li summarized at the end: number of records and transitions, transitions per second (when the records
+ *        carry timestamps), maximum groupsWaiting and turnaround of each group.
+ *
+ *  With option <tt>-s</tt> (log written by the sampling monitor), groups may skip states between two records.
+ *  With option <tt>-t</tt>, the filtered view includes the sequence number and timestamp columns.
+ *
+ *  Upon execution, one optional parameter is accepted:
+ *    \li name of the log file (stdin if missing).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "logging.h"
+
+/** \brief size of the output buffer */
+#define  OUTBUF_SIZE       65536
+
+/**
+ *  \brief Definition of the life cycle of a group, as seen in the log.
+ */
+typedef struct {
+    /** \brief record where the group leaves GOTOREST (-1 if not seen) */
+    long arrived;
+    /** \brief record where the group reaches LEAVING (-1 if not seen) */
+    long left;
+    /** \brief timestamps of those records (ns) */
+    long long tArrived, tLeft;
+} GROUP_TRACE;
+
+/** \brief life cycle of each group */
+static GROUP_TRACE *trace;
+
+/** \brief group using each table in the record being checked: valid if its record number is the one of the record */
+static struct {
+    long rec;
+    int group;
+} *owner;
+
+/** \brief number of entries of <tt>owner</tt> (tables are numbered as they show up in the log) */
+static int nOwner = 0;
+
+/** \brief number of invariant violations found */
+static unsigned long nViolations = 0;
+
+/** \brief reports an invariant violation of record r */
+static void violation (long r, char *fmt, ...)
+{
+    va_list ap;
+
+    va_start (ap, fmt);
+    fprintf (stderr, "record %ld: ", r);
+    vfprintf (stderr, fmt, ap);
+    fprintf (stderr, "\n");
+    va_end (ap);
+    nViolations += 1;
+}
+
+/** \brief makes room in <tt>owner</tt> for table t */
+static void addTable (int t)
+{
+    int n = (t < 2 * nOwner) ? 2 * nOwner : t + 1;
+
+    if ((owner = realloc (owner, n * sizeof (*owner))) == NULL) {
+        perror ("error on allocating the table owners");
+        exit (EXIT_FAILURE);
+    }
+    while (nOwner < n) {
+        owner[nOwner++].rec = -1;
+    }
+}
+
+/**
+ *  \brief checks the invariants of record r, given the previous one, and updates the life cycle of the groups.
+ */
+static void checkRecord (long r, LOG_RECORD *p_rec, LOG_RECORD *p_prev, bool sampled)
+{
+    int *stat = recGroupStat (p_rec), *table = recAssignedTable (p_rec);
+    int g, t, s, prev;
+
+    if (p_rec->groupsWaiting < 0) {
+        violation (r, "groupsWaiting is negative (%d)", p_rec->groupsWaiting);
+    }
+
+    for (g = 0; g < p_rec->nGroups; g++) {
+        t = table[g];
+        if (t == -1) {
+            continue;
+        }
+        if (t < 0) {
+            violation (r, "group %d assigned to unknown table %d", g, t);
+            continue;
+        }
+        if (t >= nOwner) {
+            addTable (t);
+        }
+        if (owner[t].rec == r) {
+            violation (r, "table %d assigned to groups %d and %d", t, owner[t].group, g);
+        }
+        else {
+            owner[t].rec = r;
+            owner[t].group = g;
+        }
+    }
+
+    for (g = 0; g < p_rec->nGroups; g++) {
+        s = stat[g];
+        prev = (p_prev != NULL) ? recGroupStat (p_prev)[g] : GOTOREST;
+        if ((s < GOTOREST) || (s > LEAVING)) {
+            violation (r, "group %d in unknown state %d", g, s);
+            continue;
+        }
+        if (s < prev) {
+            violation (r, "group %d goes back from state %d to %d", g, prev, s);
+        }
+        else if (!sampled && (s > prev + 1)) {
+            violation (r, "group %d skips from state %d to %d", g, prev, s);
+        }
+        if ((s > GOTOREST) && (trace[g].arrived == -1)) {
+            trace[g].arrived = r;
+            trace[g].tArrived = p_rec->ts;
+        }
+        if ((s == LEAVING) && (trace[g].left == -1)) {
+            trace[g].left = r;
+            trace[g].tLeft = p_rec->ts;
+        }
+    }
+}
+
+/** \brief checks whether a record differs from the previous one in any column */
+static bool changed (LOG_RECORD *p_rec, LOG_RECORD *p_prev)
+{
+    return (memcmp (p_rec->st.chefStat, p_prev->st.chefStat, p_rec->nChefs * sizeof (unsigned int)) != 0) ||
+           (memcmp (p_rec->st.waiterStat, p_prev->st.waiterStat, p_rec->nWaiters * sizeof (unsigned int)) != 0) ||
+           (p_rec->st.receptionistStat != p_prev->st.receptionistStat) ||
+           (p_rec->groupsWaiting != p_prev->groupsWaiting) ||
+           (memcmp (p_rec->group, p_prev->group, 2 * p_rec->nGroups * sizeof (int)) != 0);
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    static char outBuf[OUTBUF_SIZE];                                                            /* stdout buffer */
+    FILE *fic = stdin;                                                                                  /* log file */
+    LOG_RECORD *rec,                                                                               /* current record */
+               *prev;                                                                             /* previous record */
+    LOG_REORDER ro;                                                                      /* records read ahead */
+    long n = 0,                                                                                 /* number of records */
+         nTransitions = 0;                                                          /* records that change the state */
+    long long t0 = 0, t1 = 0;                                                        /* first and last timestamps */
+    int opt, format, nGroups, nWaiters, nChefs, g,
+        maxWaiting = 0;
+    bool quiet = false,
+         sampled = false,
+         stamped = false;
+
+    while ((opt = getopt (argc, argv, "qst")) != -1) {
+        switch (opt) {
+            case 'q':
+                quiet = true;
+                break;
+            case 's':
+                sampled = true;
+                break;
+            case 't':
+                stamped = true;
+                break;
+            default:
+                fprintf (stderr, "USAGE: %s [-q] [-s] [-t] [log-file]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if ((argc - optind == 1) && ((fic = fopen (argv[optind], "r")) == NULL)) {
+        perror ("error on opening log file");
+        return EXIT_FAILURE;
+    }
+    setvbuf (stdout, outBuf, _IOFBF, sizeof (outBuf));
+
+    if ((format = readLogHeader (fic, &nGroups, &nWaiters, &nChefs)) == -1) {
+        fprintf (stderr, "Not a log file!\n");
+        return EXIT_FAILURE;
+    }
+
+    rec = newLogRecord (nGroups, nWaiters, nChefs);
+    prev = newLogRecord (nGroups, nWaiters, nChefs);
+    initLogReorder (&ro, nGroups, nWaiters, nChefs);
+    if ((trace = malloc (nGroups * sizeof (GROUP_TRACE))) == NULL) {
+        perror ("error on allocating the life cycle of the groups");
+        return EXIT_FAILURE;
+    }
+    for (g = 0; g < nGroups; g++) {
+        trace[g].arrived = trace[g].left = -1;
+    }
+    if (!quiet) {
+        printFilteredTitle (stdout, nGroups, nWaiters, nChefs, stamped);
+    }
+
+    while (readLogRecordInOrder (fic, format, nGroups, &ro, rec) == 0) {
+        if (!quiet) {
+            printFilteredRecord (stdout, rec, (n > 0) ? prev : NULL, stamped);
+        }
+        checkRecord (n, rec, (n > 0) ? prev : NULL, sampled);
+        if ((n > 0) && changed (rec, prev)) {
+            nTransitions += 1;
+        }
+        if (rec->groupsWaiting > maxWaiting) {
+            maxWaiting = rec->groupsWaiting;
+        }
+        if (n == 0) {
+            t0 = rec->ts;
+        }
+        t1 = rec->ts;
+        copyLogRecord (prev, rec);
+        n++;
+    }
+
+    /* summary */
+    if (!quiet) {
+        printf ("\n");
+    }
+    printf ("records %ld   transitions %ld", n, nTransitions);
+    if (t1 > t0) {
+        printf ("   duration %.3f ms   transitions/s %.1f", (t1 - t0) / 1e6, nTransitions / ((t1 - t0) / 1e9));
+    }
+    printf ("   max groupsWaiting %d   invariant violations %lu\n", maxWaiting, nViolations);
+    for (g = 0; g < nGroups; g++) {
+        printf ("G%02d ", g);
+        if ((trace[g].arrived == -1) || (trace[g].left == -1)) {
+            printf ("did not complete\n");
+            continue;
+        }
+        printf ("arrived at record %ld, left at record %ld, turnaround %ld records",
+                trace[g].arrived, trace[g].left, trace[g].left - trace[g].arrived);
+        if (t1 > t0) {
+            printf (" (%.3f ms)", (trace[g].tLeft - trace[g].tArrived) / 1e6);
+        }
+        printf ("\n");
+    }
+
+    if (fic != stdin) {
+        fclose (fic);
+    }
+    return (nViolations == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
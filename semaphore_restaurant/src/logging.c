@@ -7,7 +7,11 @@
  *
  *  Defined operations:
  *     \li file initialization
- *     \li writing the present full state as a single line at the end of the file.
+ *     \li opening, flushing and closing a per-process logging session, optionally on a log segment of its own
+ *     \li writing the present full state as a single line at the end of the file
+ *     \li taking a snapshot of the state inside the critical region and writing it after leaving it
+ *     \li handing records over to a logger process through a ring buffer in shared memory
+ *     \li reading back and printing records of a log file, in the text or the filtered layout.
  *
  *  \author Nuno Lau - December 2023
  */
@@ -15,24 +19,107 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdbool.h>
 
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sched.h>
+
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include <unistd.h>
 
 
 #include "probConst.h"
 #include "probDataStruct.h"
+#define  LOG_SAMPLER
+#include "logging.h"
+
+/** \brief descriptor of the log file kept open by the logging session of this process (-1 if no session is open) */
+static int session = -1;
+
+/** \brief shared logging control data of the session (NULL if records carry no sequence number) */
+static LOG_CTL *ctl = NULL;
+
+/** \brief set once the header of the log segment of this process has been written */
+static bool segHeader = false;
+
+/** \brief size of the fixed part of a binary record with w waiters and k chefs: seq, ts, role states */
+#define  BINREC_FIXED(w, k)  (4 + 8 + 1 + (size_t) (w) + (size_t) (k))
+
+/** \brief number of columns of a record: role states (k chefs, w waiters, receptionist), group states, groupsWaiting,
+ *  assigned tables */
+#define  NCOLUMNS(n, w, k) (2 + (size_t) (k) + (size_t) (w) + 2 * (size_t) (n))
+/** \brief largest number of columns of a record of n groups */
+#define  NCOLUMNS_MAX(n)   NCOLUMNS (n, MAXWAITERS, MAXCHEFS)
+/** \brief maximum size of a delta record: seq and ts increments, change mask, all columns */
+#define  DELTAREC_MAX(n)   (10 + 10 + (NCOLUMNS_MAX (n) + 7) / 8 + 5 * NCOLUMNS_MAX (n))
+/** \brief width of the sequence number column of a stamped text record */
+#define  SEQ_WIDTH         8
+/** \brief width of the timestamp column of a stamped text record */
+#define  TS_WIDTH          14
+/** \brief maximum size of an encoded record in any format (a text column takes at most 12 characters, a timestamp 20) */
+#define  LOGREC_MAX(n)     (12 * NCOLUMNS_MAX (n) + 12 + 20 + 2 + DELTAREC_MAX (n))
+/** \brief maximum size of the title and column header of the text format */
+#define  LOGTITLE_MAX(n)   (128 + 4 * (MAXWAITERS + MAXCHEFS) + 24 * (size_t) (n))
+/** \brief size of the buffer where the logger process batches records (at least) */
+#define  LOG_BATCH_SIZE    65536
+/** \brief largest number of groups accepted in the header of a log file */
+#define  LOG_MAXGROUPS     (1 << 24)
+/** \brief futex bit of the writer of record seq: a turn only wakes the writers whose bit matches */
+#define  TURN_BIT(seq)     (1U << ((seq) % 32))
+
+/** \brief records encoded by the logger process and not yet written */
+static unsigned char *batch = NULL;
+
+/** \brief size of <tt>batch</tt> */
+static size_t batchSize = 0;
+
+/** \brief number of bytes in <tt>batch</tt> */
+static size_t batchLen = 0;
+
+/** \brief buffer where a record is encoded or decoded, grown on demand */
+static unsigned char *work = NULL;
+
+/** \brief size of <tt>work</tt> */
+static size_t workSize = 0;
+
+/** \brief record of the state written by <tt>saveState</tt> */
+static LOG_RECORD *saved = NULL;
 
 /* internal functions */
 
-static FILE *openLog(char nFic[], char mode[])
+/** \brief grows a buffer allocated on demand to hold at least size bytes; returns its new location */
+static void *reserve (void *buf, size_t *p_size, size_t size)
+{
+    if (size > *p_size) {
+        if ((buf = realloc (buf, size)) == NULL) {
+            perror ("error on allocating a log buffer");
+            exit (EXIT_FAILURE);
+        }
+        *p_size = size;
+    }
+    return buf;
+}
+
+/** \brief buffer <tt>work</tt>, with room for at least size bytes */
+static unsigned char *workBuf (size_t size)
+{
+    return work = reserve (work, &workSize, size);
+}
+
+static int openLog(char nFic[], char mode[])
 {
-    FILE *fic;
+    int fd;
     char *fName;                                                                                      /* log file name */
 
     if ((nFic == NULL) || (strlen (nFic) == 0)) {
-        return stdout;
+        return STDOUT_FILENO;
     }
     else  {
         fName = nFic;
@@ -40,48 +127,705 @@ static FILE *openLog(char nFic[], char mode[])
 
     fprintf(stderr,"%d opening log %s %s\n",getpid(),nFic,mode);
 
-    if ((fic = fopen (fName, mode)) == NULL) {
+    if ((fd = open (fName, O_WRONLY | O_CREAT | ((mode[0] == 'w') ? O_TRUNC : O_APPEND), 0666)) == -1) {
         perror ("error on opening log file");
         exit (EXIT_FAILURE);
     }
-    return fic;
+    return fd;
 }
 
-static void closeLog(FILE *fic)
+static void closeLog(int fd)
 {
-    if(fic==stderr || fic == stdout) {
-         fflush(fic);
+    if(fd==STDERR_FILENO || fd == STDOUT_FILENO) {
          return;
     }
 
-    if (fclose (fic) == EOF) {
+    if (close (fd) == -1) {
         perror ("error on closing of log file");
         exit (EXIT_FAILURE);
     }
 }
 
-static void printHeader(FILE *fic, FULL_STAT *p_fSt)
+/** \brief writes the whole buffer with as few write calls as possible (one, unless interrupted) */
+static void writeAll (int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write (fd, p, len)) == -1) {
+            if (errno == EINTR) continue;
+            perror ("error on writing to log file");
+            exit (EXIT_FAILURE);
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/**
+ *  \brief formats an integer right aligned in a field of the given width, as <tt>%*lld</tt> would.
+ *
+ *  \return pointer to the first character after the field
+ */
+static char *putInt (char *p, long long v, int width)
 {
-    fprintf(fic,"%3s","CH");
-    fprintf(fic,"%3s","WT");
-    fprintf(fic,"%3s","RC");
-    fprintf(fic," ");
+    char digits[21];
+    unsigned long long u = (v < 0) ? -(unsigned long long) v : (unsigned long long) v;
+    int n = 0;
+
+    do {
+        digits[n++] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (v < 0) {
+        digits[n++] = '-';
+    }
+    while (width-- > n) {
+        *p++ = ' ';
+    }
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+/** \brief number of digits of a non negative value */
+static int digits (long long v)
+{
+    int n = 1;
+
+    while (v >= 10) {
+        v /= 10;
+        n += 1;
+    }
+    return n;
+}
+
+/** \brief width of a group column of the text format (state or table): 4, or the header of the last group plus a space */
+static int groupWidth (int nGroups)
+{
+    return (nGroups > 100) ? 2 + digits (nGroups - 1) : 4;
+}
+
+/** \brief width of the groupsWaiting column of the text format: 5, or room for nGroups plus a space */
+static int waitingWidth (int nGroups)
+{
+    return (digits (nGroups) > 4) ? 1 + digits (nGroups) : 5;
+}
+
+/**
+ *  \brief header of the column of the k-th of n waiters or chefs: the single label (WT or CH) if there is a single
+ *  one, the initial followed by k (W0, W1, ... or C0, C1, ...) otherwise
+ */
+static char *staffLabel (char *label, char *single, int k, int n)
+{
+    if (n == 1) strcpy (label, single);
+    else sprintf (label, "%c%d", single[0], k);
+    return label;
+}
+
+static size_t formatHeader(char *buf, int nGroups, int nWaiters, int nChefs, bool stamped)
+{
+    char *p = buf;
+    char label[16];
+    int w = groupWidth (nGroups);
+    int k;
+
+    if (stamped) {
+        p += sprintf(p,"%*s%*s",SEQ_WIDTH,"SEQ",TS_WIDTH,"TS(ns)");
+    }
+    for(k=0; k < nChefs; k++) {
+        p += sprintf(p,"%3s",staffLabel(label,"CH",k,nChefs));
+    }
+    for(k=0; k < nWaiters; k++) {
+        p += sprintf(p,"%3s",staffLabel(label,"WT",k,nWaiters));
+    }
+    p += sprintf(p,"%3s","RC");
+    p += sprintf(p," ");
     int g;
-    for(g=0; g < p_fSt->nGroups; g++) {
-        fprintf(fic," %s%02d","G",g);
+    for(g=0; g < nGroups; g++) {
+        sprintf(label,"%s%02d","G",g);
+        p += sprintf(p,"%*s",w,label);
     }
 
-    fprintf(fic,"%5s","gWT");
+    p += sprintf(p,"%*s",waitingWidth(nGroups),"gWT");
 
-    for(g=0; g < p_fSt->nGroups; g++) {
-        fprintf(fic," %s%02d","T",g);
+    for(g=0; g < nGroups; g++) {
+        sprintf(label,"%s%02d","T",g);
+        p += sprintf(p,"%*s",w,label);
     }
 
-    fprintf(fic,"\n");
+    p += sprintf(p,"\n");
+    return p - buf;
+}
+
+/** \brief formats the title line, a blank line and the column header of the text format */
+static size_t formatTitle (char *buf, int nGroups, int nWaiters, int nChefs, bool stamped)
+{
+    size_t len;
+
+    /* title line + blank line */
+
+    len = sprintf (buf, "%31cRestaurant - Description of the internal state\n\n", ' ');
+    return len + formatHeader (buf + len, nGroups, nWaiters, nChefs, stamped);
+}
+
+/**
+ *  \brief formats a record as a line of the text format.
+ *
+ *  Column widths are the ones of <tt>formatHeader</tt>: 3 for the role states (one per chef and per waiter), 4 for
+ *  each group state, 5 for groupsWaiting and 4 for each assigned table ("." if none), the last two wider with more
+ *  than 100 groups; a stamped record starts with the sequence number and the timestamp.
+ *
+ *  \return length of the line
+ */
+static size_t formatTextRecord (char *buf, LOG_RECORD *p_rec, bool stamped)
+{
+    char *p = buf;
+    int *stat = recGroupStat (p_rec), *table = recAssignedTable (p_rec);
+    int w = groupWidth (p_rec->nGroups);
+    int g, k;
+
+    if (stamped) {
+        p = putInt (p, p_rec->seq, SEQ_WIDTH);
+        p = putInt (p, p_rec->ts, TS_WIDTH);
+    }
+    for (k = 0; k < p_rec->nChefs; k++) {
+        p = putInt (p, p_rec->st.chefStat[k], 3);
+    }
+    for (k = 0; k < p_rec->nWaiters; k++) {
+        p = putInt (p, p_rec->st.waiterStat[k], 3);
+    }
+    p = putInt (p, p_rec->st.receptionistStat, 3);
+    *p++ = ' ';
+    for (g = 0; g < p_rec->nGroups; g++) {
+        p = putInt (p, stat[g], w);
+    }
+    p = putInt (p, p_rec->groupsWaiting, waitingWidth (p_rec->nGroups));
+    for (g = 0; g < p_rec->nGroups; g++) {
+        if (table[g] != -1) {
+            p = putInt (p, table[g], w);
+        }
+        else {
+            memset (p, ' ', w - 1);
+            p += w - 1;
+            *p++ = '.';
+        }
+    }
+    *p++ = '\n';
+    return p - buf;
+}
+
+/** \brief format of the records written by the session (log segments are always binary) */
+static int recordFormat (void)
+{
+    if (ctl == NULL) {
+        return LOG_TEXT;
+    }
+    return ctl->perProcess ? LOG_BINARY : ctl->format;
+}
+
+/** \brief text records of the session carry sequence number and timestamp columns */
+static bool isStamped (void)
+{
+    return (ctl != NULL) && ctl->stamped;
+}
+
+/**
+ *  \brief writes the header of a binary or delta log file: magic tag, format version, number of groups, number of
+ *  waiters and number of chefs
+ */
+static void writeBinHeader (int fd, int format, int nGroups, int nWaiters, int nChefs)
+{
+    char magic[8] = LOG_MAGIC;                                                         /* binary file identification */
+    unsigned int hdr[4] = { LOG_VERSION, nGroups, nWaiters, nChefs };                      /* binary file parameters */
+
+    if (format == LOG_DELTA) {
+        strcpy (magic, LOG_DELTA_MAGIC);
+    }
+    writeAll (fd, magic, sizeof (magic));
+    writeAll (fd, hdr, sizeof (hdr));
+}
+
+/**
+ *  \brief size of the columns of a binary record that count groups (groupsWaiting) or tables (a table is only
+ *  assigned when a lower one is not free, so its number is lower than the number of groups): 2 bytes, 4 with more
+ *  than INT16_MAX groups.
+ */
+static size_t countSize (int nGroups)
+{
+    return (nGroups > INT16_MAX) ? 4 : 2;
+}
+
+/** \brief appends a column of countSize bytes */
+static unsigned char *putCount (unsigned char *p, int v, size_t size)
+{
+    int16_t v16 = (int16_t) v;
+    int32_t v32 = v;
+
+    if (size == 2) memcpy (p, &v16, 2);
+    else memcpy (p, &v32, 4);
+    return p + size;
+}
+
+/** \brief value of a column of countSize bytes */
+static int getCount (unsigned char *p, size_t size)
+{
+    int16_t v16;
+    int32_t v32;
+
+    if (size == 2) {
+        memcpy (&v16, p, 2);
+        return v16;
+    }
+    memcpy (&v32, p, 4);
+    return v32;
+}
+
+/** \brief size of a binary record for nGroups groups, nWaiters waiters and nChefs chefs */
+static size_t binRecordSize (int nGroups, int nWaiters, int nChefs)
+{
+    return BINREC_FIXED (nWaiters, nChefs) + (1 + (size_t) nGroups) * countSize (nGroups) + nGroups;
+}
+
+/** \brief last record written, reference of the next delta record */
+static LOG_RECORD *lastRecord (LOG_CTL *p_ctl)
+{
+    return (LOG_RECORD *) ((char *) p_ctl + p_ctl->lastOff);
+}
+
+/** \brief slot of ring position pos */
+static LOG_SLOT *ringSlot (LOG_CTL *p_ctl, unsigned long long pos)
+{
+    return (LOG_SLOT *) ((char *) p_ctl + p_ctl->slotOff + (pos & (p_ctl->ring.size - 1)) * p_ctl->slotSize);
+}
+
+/** \brief record held by a slot of the ring */
+static LOG_RECORD *slotRecord (LOG_SLOT *slot)
+{
+    return (LOG_RECORD *) (slot + 1);
+}
+
+/** \brief record of nGroups groups where <tt>saveState</tt> takes the state */
+static LOG_RECORD *savedRecord (int nGroups, int nWaiters, int nChefs)
+{
+    if ((saved != NULL) && (saved->nGroups != nGroups)) {
+        free (saved);
+        saved = NULL;
+    }
+    if (saved == NULL) {
+        saved = newLogRecord (nGroups, nWaiters, nChefs);
+    }
+    return saved;
+}
+
+/**
+ *  \brief fills a log record from the full state, tagging it with the next sequence number and the present time.
+ */
+static void captureRecord (LOG_RECORD *p_rec, FULL_STAT *p_fSt)
+{
+    struct timespec now;
+
+    if (ctl != NULL) {
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        p_rec->seq = __atomic_fetch_add (&ctl->seq, 1, __ATOMIC_RELAXED);
+        p_rec->ts = (long long) now.tv_sec * 1000000000LL + now.tv_nsec - ctl->t0;
+    }
+    else {
+        p_rec->seq = 0;
+        p_rec->ts = 0;
+    }
+    p_rec->st = p_fSt->st;
+    p_rec->nGroups = p_fSt->nGroups;
+    p_rec->nWaiters = p_fSt->nWaiters;
+    p_rec->nChefs = p_fSt->nChefs;
+    p_rec->groupsWaiting = p_fSt->groupsWaiting;
+    memcpy (recGroupStat (p_rec), groupStat (p_fSt), p_fSt->nGroups * sizeof (int));
+    memcpy (recAssignedTable (p_rec), assignedTable (p_fSt), p_fSt->nGroups * sizeof (int));
+}
+
+/**
+ *  \brief encodes a record in binary format.
+ *
+ *  Layout (host byte order): seq (4 bytes), ts (8), chefs, waiters and receptionist states (1 each),
+ *  groupsWaiting (2), state of each group (1 each), table of each group (2 each, -1 if none); groupsWaiting
+ *  and the tables take 4 bytes each with more than INT16_MAX groups.
+ *
+ *  \return size of the record
+ */
+static size_t encodeBinRecord (unsigned char *buf, LOG_RECORD *p_rec)
+{
+    unsigned char *p = buf;
+    int *stat = recGroupStat (p_rec), *table = recAssignedTable (p_rec);
+    size_t size = countSize (p_rec->nGroups);
+    int g, k;
+
+    memcpy (p, &p_rec->seq, 4);                 p += 4;
+    memcpy (p, &p_rec->ts, 8);                  p += 8;
+    for (k = 0; k < p_rec->nChefs; k++) {
+        *p++ = (unsigned char) p_rec->st.chefStat[k];
+    }
+    for (k = 0; k < p_rec->nWaiters; k++) {
+        *p++ = (unsigned char) p_rec->st.waiterStat[k];
+    }
+    *p++ = (unsigned char) p_rec->st.receptionistStat;
+    p = putCount (p, p_rec->groupsWaiting, size);
+    for (g = 0; g < p_rec->nGroups; g++) {
+        *p++ = (unsigned char) stat[g];
+    }
+    for (g = 0; g < p_rec->nGroups; g++) {
+        p = putCount (p, table[g], size);
+    }
+    return p - buf;
+}
+
+/** \brief value of column c of a record (see NCOLUMNS) */
+static int getColumn (LOG_RECORD *p_rec, int c)
+{
+    int n = p_rec->nGroups, k = p_rec->nChefs, r = k + p_rec->nWaiters;             /* r: chef and waiter columns */
+
+    if (c < k) return p_rec->st.chefStat[c];
+    if (c < r) return p_rec->st.waiterStat[c - k];
+    if (c == r) return p_rec->st.receptionistStat;
+    if (c < 1 + r + n) return p_rec->group[c - 1 - r];
+    if (c == 1 + r + n) return p_rec->groupsWaiting;
+    return p_rec->group[c - 2 - r];
+}
+
+/** \brief sets the value of column c of a record (see NCOLUMNS) */
+static void setColumn (LOG_RECORD *p_rec, int c, int v)
+{
+    int n = p_rec->nGroups, k = p_rec->nChefs, r = k + p_rec->nWaiters;             /* r: chef and waiter columns */
+
+    if (c < k) p_rec->st.chefStat[c] = v;
+    else if (c < r) p_rec->st.waiterStat[c - k] = v;
+    else if (c == r) p_rec->st.receptionistStat = v;
+    else if (c < 1 + r + n) p_rec->group[c - 1 - r] = v;
+    else if (c == 1 + r + n) p_rec->groupsWaiting = v;
+    else p_rec->group[c - 2 - r] = v;
+}
+
+/** \brief appends a signed value as a zigzag varint (1 byte for values in -64..63) */
+static unsigned char *putVarint (unsigned char *p, long long v)
+{
+    unsigned long long u = ((unsigned long long) v << 1) ^ (unsigned long long) (v >> 63);
+
+    while (u >= 0x80) {
+        *p++ = (unsigned char) (u | 0x80);
+        u >>= 7;
+    }
+    *p++ = (unsigned char) u;
+    return p;
+}
+
+/** \brief reads a zigzag varint; returns -1 at end of file */
+static int getVarint (FILE *fic, long long *p_v)
+{
+    unsigned long long u = 0;
+    int c, shift = 0;
+
+    do {
+        if (((c = getc (fic)) == EOF) || (shift > 63)) {
+            return -1;
+        }
+        u |= (unsigned long long) (c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    *p_v = (long long) (u >> 1) ^ -(long long) (u & 1);
+    return 0;
+}
+
+/**
+ *  \brief encodes a record in delta format.
+ *
+ *  Layout: seq and ts increments over the last record written, a mask with one bit per column
+ *  (set if the column changed), and the value of each changed column, all values as zigzag varints.
+ *  The reference record is kept in the shared logging control data, since records of all processes go
+ *  to the same file in production order.
+ *
+ *  \return size of the record
+ */
+static size_t encodeDeltaRecord (unsigned char *buf, LOG_RECORD *p_rec)
+{
+    unsigned char *p = buf, *mask;
+    LOG_RECORD *last = lastRecord (ctl);
+    int c, nCol = NCOLUMNS (p_rec->nGroups, p_rec->nWaiters, p_rec->nChefs);
+
+    if (!ctl->hasLast) {
+        last->seq = 0;
+        last->ts = 0;
+    }
+    p = putVarint (p, (long long) p_rec->seq - last->seq);
+    p = putVarint (p, p_rec->ts - last->ts);
+    mask = p;
+    memset (mask, 0, (nCol + 7) / 8);
+    p += (nCol + 7) / 8;
+    for (c = 0; c < nCol; c++) {
+        if (!ctl->hasLast || (getColumn (p_rec, c) != getColumn (last, c))) {
+            mask[c / 8] |= 1 << (c % 8);
+            p = putVarint (p, getColumn (p_rec, c));
+        }
+    }
+    copyLogRecord (last, p_rec);
+    ctl->hasLast = 1;
+    return p - buf;
+}
+
+/**
+ *  \brief encodes a record in the format selected in the logging control data.
+ *
+ *  \param buf buffer with room for at least LOGREC_MAX bytes for the number of groups of the record
+ *  \param p_rec pointer to the record
+ *
+ *  \return size of the encoded record
+ */
+static size_t encodeRecord (unsigned char *buf, LOG_RECORD *p_rec)
+{
+    if (recordFormat () == LOG_BINARY) {
+        return encodeBinRecord (buf, p_rec);
+    }
+    if (recordFormat () == LOG_DELTA) {
+        return encodeDeltaRecord (buf, p_rec);
+    }
+    return formatTextRecord ((char *) buf, p_rec, isStamped ());
+}
+
+/**
+ *  \brief copies a record into the ring buffer.
+ *
+ *  A producer claims the head position with a compare and swap once the slot of that position is free,
+ *  fills the slot and publishes it by advancing its ticket. If the ring is full, the producer either waits
+ *  for the logger process or drops the record, according to the overflow policy; it never waits for a logger
+ *  process that terminated early.
+ */
+static void pushRecord (LOG_CTL *p_ctl, LOG_RECORD *p_rec)
+{
+    LOG_RING *p_ring = &p_ctl->ring;
+    unsigned long long pos, ticket;
+    LOG_SLOT *slot;
+
+    pos = __atomic_load_n (&p_ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = ringSlot (p_ctl, pos);
+        ticket = __atomic_load_n (&slot->ticket, __ATOMIC_ACQUIRE);
+        if (ticket == pos) {
+            if (__atomic_compare_exchange_n (&p_ring->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (ticket < pos) {                                                                 /* ring is full */
+            if ((p_ring->overflow == LOG_DROP) || __atomic_load_n (&p_ring->abandoned, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add (&p_ring->dropped, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            sched_yield ();
+            pos = __atomic_load_n (&p_ring->head, __ATOMIC_RELAXED);
+        }
+        else pos = __atomic_load_n (&p_ring->head, __ATOMIC_RELAXED);
+    }
+
+    copyLogRecord (slotRecord (slot), p_rec);
+    __atomic_store_n (&slot->ticket, pos + 1, __ATOMIC_RELEASE);
+}
+
+/** \brief records of the session carry what readers need to put them back in sequence order */
+static bool selfOrdered (void)
+{
+    return (recordFormat () == LOG_BINARY) || ((recordFormat () == LOG_TEXT) && isStamped ());
+}
+
+/**
+ *  \brief waits for the records with lower sequence numbers to be written.
+ *
+ *  The writer sleeps on the futex of <tt>written</tt>, and is only woken by the writer of the record before its own
+ *  (or by another one whose turn bit matches, after which it goes back to sleep).
+ */
+static void waitTurn (unsigned int seq)
+{
+    unsigned int w;
+
+    while ((w = __atomic_load_n (&ctl->written, __ATOMIC_ACQUIRE)) != seq) {
+        syscall (SYS_futex, &ctl->written, FUTEX_WAIT_BITSET, w, NULL, NULL, TURN_BIT (seq));
+    }
+}
+
+/** \brief hands the turn over to the writer of the record after seq */
+static void passTurn (unsigned int seq)
+{
+    __atomic_store_n (&ctl->written, seq + 1, __ATOMIC_RELEASE);
+    syscall (SYS_futex, &ctl->written, FUTEX_WAKE_BITSET, INT_MAX, NULL, NULL, TURN_BIT (seq + 1));
+}
+
+/**
+ *  \brief takes the next record out of the ring buffer (single consumer).
+ *
+ *  \return true if a record was available
+ */
+static bool popRecord (LOG_CTL *p_ctl, LOG_RECORD *p_rec)
+{
+    LOG_RING *p_ring = &p_ctl->ring;
+    unsigned long long pos = p_ring->tail;
+    LOG_SLOT *slot = ringSlot (p_ctl, pos);
+
+    if (__atomic_load_n (&slot->ticket, __ATOMIC_ACQUIRE) != pos + 1) {
+        return false;
+    }
+    copyLogRecord (p_rec, slotRecord (slot));
+    __atomic_store_n (&slot->ticket, pos + p_ring->size, __ATOMIC_RELEASE);
+    p_ring->tail = pos + 1;
+    return true;
+}
+
+/** \brief number of slots of the ring for nGroups groups */
+static unsigned int ringSize (int nGroups)
+{
+    unsigned int n = LOG_RING_SIZE;
+    size_t slotSize = CACHE_ROUND (sizeof (LOG_SLOT) + logRecordSize (nGroups));
+
+    while ((n > LOG_RING_MIN) && (n * slotSize > LOG_RING_BYTES)) {
+        n /= 2;
+    }
+    return n;
 }
 
 /* external functions */
 
+/**
+ *  \brief Size of a record of nGroups groups (bytes).
+ */
+size_t logRecordSize (int nGroups)
+{
+    return sizeof (LOG_RECORD) + 2 * (size_t) nGroups * sizeof (int);
+}
+
+/**
+ *  \brief Allocation of a record of nGroups groups, nWaiters waiters and nChefs chefs, all its columns set to 0.
+ *
+ *  \return pointer to the record (the process exits if there is no memory left)
+ */
+LOG_RECORD *newLogRecord (int nGroups, int nWaiters, int nChefs)
+{
+    LOG_RECORD *p_rec;
+
+    if ((p_rec = calloc (1, logRecordSize (nGroups))) == NULL) {
+        perror ("error on allocating a log record");
+        exit (EXIT_FAILURE);
+    }
+    p_rec->nGroups = nGroups;
+    p_rec->nWaiters = nWaiters;
+    p_rec->nChefs = nChefs;
+    return p_rec;
+}
+
+/**
+ *  \brief Copy of a record onto a record of the same number of groups.
+ */
+void copyLogRecord (LOG_RECORD *p_dst, LOG_RECORD *p_src)
+{
+    memcpy (p_dst, p_src, logRecordSize (p_src->nGroups));
+}
+
+/**
+ *  \brief Size of the data that follows the logging control data for nGroups groups (bytes).
+ *
+ *  The data is the last record written (reference of the next delta record) and, if the log ring buffer may be
+ *  used, its slots, each one on cache lines of its own.
+ *
+ *  \param nGroups number of groups
+ *  \param ring room is made for the slots of the log ring buffer
+ */
+size_t logCtlDataSize (int nGroups, bool ring)
+{
+    size_t size = CACHE_ROUND (logRecordSize (nGroups));
+
+    if (ring) {
+        size += ringSize (nGroups) * CACHE_ROUND (sizeof (LOG_SLOT) + logRecordSize (nGroups));
+    }
+    return size;
+}
+
+/**
+ *  \brief Location of the data of the logging control data in the logCtlDataSize bytes at p_data (aligned on a
+ *  cache line, after the control data).
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ *  \param p_data pointer to the data
+ *  \param nGroups number of groups
+ *  \param ring the data has room for the slots of the log ring buffer
+ */
+void setLogCtlData (LOG_CTL *p_ctl, void *p_data, int nGroups, bool ring)
+{
+    p_ctl->nGroups = nGroups;
+    p_ctl->hasLast = 0;
+    p_ctl->lastOff = (char *) p_data - (char *) p_ctl;
+    lastRecord (p_ctl)->nGroups = nGroups;
+    p_ctl->slotOff = p_ctl->lastOff + CACHE_ROUND (logRecordSize (nGroups));
+    p_ctl->slotSize = CACHE_ROUND (sizeof (LOG_SLOT) + logRecordSize (nGroups));
+    p_ctl->ring.size = ring ? ringSize (nGroups) : 0;
+}
+
+/**
+ *  \brief Opening of the logging session of the calling process.
+ *
+ *  The logging file is opened in append mode (<tt>O_APPEND</tt>) once and kept open until the session is closed,
+ *  so that <tt>saveState</tt> no longer has to open and close the file on every call.
+ *  If <tt>nFic</tt> is a null pointer or a null string, stdout is used.
+ *  When the log ring buffer is enabled, no file is opened: records are handed to the logger process.
+ *  In per-process mode, the session truncates the binary log segment <tt>nFic_tag</tt> of the calling process,
+ *  whose header is written along with the first record; records of a segment need not wait for the other
+ *  processes, and the segments of a run are merged back in sequence order by <tt>restaurantlog</tt>.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_ctl pointer to the shared logging control data (NULL for text records without sequence numbers)
+ *  \param tag name of the calling entity, as in its error file (GR00, WT, CH, RT, ...)
+ */
+void openLogSession (char nFic[], LOG_CTL *p_ctl, char tag[])
+{
+    char segName[80];                                                                          /* name of log segment */
+
+    if (session != -1) {
+        closeLogSession ();
+    }
+    ctl = p_ctl;
+    if ((ctl != NULL) && ctl->perProcess) {
+        snprintf (segName, sizeof (segName), "%s_%s", nFic, tag);
+        session = openLog (segName, "w");
+        segHeader = false;
+    }
+    else if ((ctl == NULL) || !ctl->ring.enabled) {
+        session = openLog (nFic, "a");
+    }
+}
+
+/**
+ *  \brief Flushing of the records buffered by the logging session.
+ *
+ *  Only the logger process batches records; the other processes write each record as it is produced.
+ */
+void flushLog (void)
+{
+    if ((session != -1) && (batchLen > 0)) {
+        writeAll (session, batch, batchLen);
+        batchLen = 0;
+    }
+}
+
+/**
+ *  \brief Closing of the logging session of the calling process.
+ *
+ *  Pending records are flushed and the logging file is closed.
+ */
+void closeLogSession (void)
+{
+    if (session != -1) {
+        flushLog ();
+        closeLog (session);
+        session = -1;
+    }
+    ctl = NULL;
+}
+
 /**
  *  \brief File initialization.
  *
@@ -92,65 +836,693 @@ static void printHeader(FILE *fic, FULL_STAT *p_fSt)
  *       \li a title line
  *       \li a blank line.
  *
+ *  In binary and delta formats (selected through the logging session), the header is a <tt>LOG_MAGIC</tt> or
+ *  <tt>LOG_DELTA_MAGIC</tt> tag followed by the format version, the number of groups, the number of waiters and the
+ *  number of chefs.
+ *  Records that must reach the file in sequence order (see <tt>writeSnapshot</tt>) start with the next one taken.
+ *  In per-process mode nothing is done: every log segment is written with its own header.
+ *
  *  \param nFic name of the logging file
  */
 void createLog (char nFic[], FULL_STAT *p_fSt)
 {
-    FILE *fic;                                                                                      /* file descriptor */
+    int fd;                                                                                         /* file descriptor */
+    char *title;                                                                        /* text title and header */
 
-    fic = openLog(nFic,"w");
+    if ((ctl != NULL) && ctl->perProcess) {
+        return;                                                              /* every segment has its own header */
+    }
 
-    /* title line + blank line */
+    fd = openLog(nFic,"w");
 
-    fprintf (fic, "%31cRestaurant - Description of the internal state\n\n", ' ');
-    printHeader(fic, p_fSt);
+    if (ctl != NULL) {
+        ctl->written = ctl->seq;                                  /* records in order start with the next one taken */
+    }
+    if ((ctl != NULL) && ((ctl->format == LOG_BINARY) || (ctl->format == LOG_DELTA))) {
+        if (ctl->format == LOG_DELTA) {
+            ctl->hasLast = 0;
+        }
+        writeBinHeader (fd, ctl->format, p_fSt->nGroups, p_fSt->nWaiters, p_fSt->nChefs);
+    }
+    else {
+        title = (char *) workBuf (LOGTITLE_MAX (p_fSt->nGroups));
+        writeAll (fd, title, formatTitle (title, p_fSt->nGroups, p_fSt->nWaiters, p_fSt->nChefs, isStamped ()));
+    }
 
-    closeLog(fic);
+    closeLog(fd);
 }
 
 /**
  *  \brief Writing the present full state as a single line at the end of the file.
  *
- *  If <tt>nFic</tt> is a null pointer or a null string, the lines are written to stdout
- *
- *  The following layout is obeyed for the full state in a single line
- *    \li chef state
- *    \li waiter state 
- *    \li receptioninst state 
- *    \li groups state 
- *    \li table assigned to each group
+ *  If <tt>nFic</tt> is a null pointer or a null string, the lines are written to stdout.
+ *  Same as <tt>snapshotState</tt> followed by <tt>writeSnapshot</tt>, for callers that do not mind formatting
+ *  and writing the record inside the critical region.
+ *  The record is formatted into a local buffer and written with a single <tt>write</tt>: if a logging
+ *  session is open, on its descriptor (opened with <tt>O_APPEND</tt>, so that records of different processes
+ *  never interleave), otherwise on a descriptor opened and closed for this single record.
+ *  When the log ring buffer is enabled, the record is only copied into the ring.
+ *  The record is written in the format selected in the shared logging control data of the session
+ *  (see <tt>printLogRecord</tt> for the text layout).
  *
  *  \param nFic name of the logging file
  *  \param p_fSt pointer to the location where the full internal state of the problem is stored
  */
 void saveState (char nFic[], FULL_STAT *p_fSt)
 {
-    FILE *fic;                                                                                      /* file descriptor */
+    LOG_RECORD *rec = savedRecord (p_fSt->nGroups, p_fSt->nWaiters, p_fSt->nChefs);              /* record to write */
 
-    fic = openLog(nFic,"a");
+    snapshotState (rec, p_fSt);
+    writeSnapshot (nFic, rec);
+}
 
-    fprintf(fic,"%3d",p_fSt->st.chefStat);
-    fprintf(fic,"%3d",p_fSt->st.waiterStat);
-    fprintf(fic,"%3d",p_fSt->st.receptionistStat);
-    fprintf(fic," ");
-    int g;
-    for(g=0; g < p_fSt->nGroups; g++) {
-        fprintf(fic,"%4d",p_fSt->st.groupStat[g]);
+/**
+ *  \brief Taking a snapshot of the present full state.
+ *
+ *  To be called inside the critical region: the state is copied and tagged with the next sequence number,
+ *  so that formatting and file I/O can be done by <tt>writeSnapshot</tt> after leaving it.
+ *  When the log ring buffer is enabled, the snapshot is copied straight into the ring.
+ *
+ *  \param p_rec pointer to the location where the snapshot is stored
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+void snapshotState (LOG_RECORD *p_rec, FULL_STAT *p_fSt)
+{
+    captureRecord (p_rec, p_fSt);
+    if ((ctl != NULL) && ctl->ring.enabled) {
+        pushRecord (ctl, p_rec);
+    }
+}
+
+/**
+ *  \brief Writing a snapshot taken by <tt>snapshotState</tt>.
+ *
+ *  To be called right after leaving the critical region, before any blocking operation. Binary records and
+ *  stamped text records are written straight away, in any order: they carry their sequence number, and
+ *  readers put them back in order (see <tt>readLogRecordInOrder</tt>). Plain text records carry no sequence
+ *  number and a delta record depends on the one written before it, so these reach the file in sequence order:
+ *  the writer sleeps until the snapshots taken before its own are written. A plain text record is encoded
+ *  before waiting; a delta record is only encoded when its turn comes. In per-process mode, the record goes to
+ *  the log segment of the calling process.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_rec pointer to the snapshot
+ */
+void writeSnapshot (char nFic[], LOG_RECORD *p_rec)
+{
+    int fd;                                                                                         /* file descriptor */
+    unsigned char *buf;                                                                             /* encoded record */
+    size_t len = 0;                                                                          /* size of encoded record */
+
+    if ((ctl != NULL) && ctl->ring.enabled) {
+        return;                                                                      /* already handed to the logger */
     }
+    buf = workBuf (LOGREC_MAX (p_rec->nGroups));
 
-    fprintf(fic,"%5d",p_fSt->groupsWaiting);
+    if (session == -1) {
+        fd = openLog(nFic,"a");
+        writeAll (fd, buf, formatTextRecord ((char *) buf, p_rec, isStamped ()));
+        closeLog(fd);
+        return;
+    }
+
+    if (recordFormat () != LOG_DELTA) {
+        len = encodeRecord (buf, p_rec);
+    }
+    if ((ctl != NULL) && ctl->perProcess && !segHeader) {
+        writeBinHeader (session, LOG_BINARY, p_rec->nGroups, p_rec->nWaiters, p_rec->nChefs);
+        segHeader = true;
+    }
+    if ((ctl == NULL) || ctl->perProcess || selfOrdered ()) {
+        writeAll (session, buf, len);
+        return;
+    }
+
+    waitTurn (p_rec->seq);
+    if (ctl->format == LOG_DELTA) {
+        len = encodeRecord (buf, p_rec);
+    }
+    writeAll (session, buf, len);
+    passTurn (p_rec->seq);
+}
+
+/**
+ *  \brief Initialization of the log ring buffer.
+ *
+ *  From then on, <tt>saveState</tt> only copies records into the ring; a logger process running
+ *  <tt>drainLogRing</tt> formats them and writes them to the logging file.
+ *  The data of the control data must have been located by <tt>setLogCtlData</tt> with room for the ring.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ *  \param overflow overflow policy (LOG_BLOCK or LOG_DROP)
+ */
+void createLogRing (LOG_CTL *p_ctl, int overflow)
+{
+    unsigned long long pos;
+
+    p_ctl->ring.overflow = overflow;
+    p_ctl->ring.done = 0;
+    p_ctl->ring.abandoned = 0;
+    p_ctl->ring.dropped = 0;
+    p_ctl->ring.head = p_ctl->ring.tail = 0;
+    for (pos = 0; pos < p_ctl->ring.size; pos++) {
+        ringSlot (p_ctl, pos)->ticket = pos;
+    }
+    __atomic_store_n (&p_ctl->ring.enabled, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief Signalling the logger process that no more records will be produced.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ */
+void closeLogRing (LOG_CTL *p_ctl)
+{
+    __atomic_store_n (&p_ctl->ring.done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief Signalling the producers that the logger process terminated early.
+ *
+ *  From then on, records that do not fit in the ring are dropped and counted, whatever the overflow policy.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ */
+void abandonLogRing (LOG_CTL *p_ctl)
+{
+    __atomic_store_n (&p_ctl->ring.abandoned, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief Life cycle of the logger process.
+ *
+ *  Records are taken out of the ring in production order and written to the logging file until
+ *  <tt>closeLogRing</tt> is called and the ring is empty. Being the only writer, the logger batches the
+ *  records and only writes them when the batch is full or the ring runs empty.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_ctl pointer to the shared logging control data
+ *
+ *  \return number of records written
+ */
+unsigned long drainLogRing (char nFic[], LOG_CTL *p_ctl)
+{
+    LOG_RECORD *rec = newLogRecord (p_ctl->nGroups, 1, 1);               /* record to write (overwritten by each one) */
+    size_t recMax = LOGREC_MAX (p_ctl->nGroups);                                      /* maximum size of a record */
+    unsigned long n = 0;                                                                  /* number of records written */
+    bool done;
+
+    ctl = p_ctl;
+    session = openLog (nFic, "a");
+    batch = reserve (batch, &batchSize, (LOG_BATCH_SIZE > 2 * recMax) ? LOG_BATCH_SIZE : 2 * recMax);
 
-    for(g=0; g < p_fSt->nGroups; g++) {
-        if(p_fSt->assignedTable[g]!=-1)
-            fprintf(fic,"%4d",p_fSt->assignedTable[g]);
+    for (;;) {
+        done = __atomic_load_n (&p_ctl->ring.done, __ATOMIC_ACQUIRE);
+        if (popRecord (p_ctl, rec)) {
+            batchLen += encodeRecord (batch + batchLen, rec);
+            if (batchLen > batchSize - recMax) {
+                flushLog ();
+            }
+            n += 1;
+        }
+        else if (done) {
+            break;
+        }
         else {
-            fprintf(fic,"%4s",".");
+            flushLog ();
+            usleep (LOG_DRAIN_PERIOD);
+        }
+    }
+
+    closeLogSession ();
+    free (rec);
+    return n;
+}
+
+/** \brief line of a text log file, grown on demand */
+static char *line = NULL;
+
+/** \brief size of <tt>line</tt> */
+static size_t lineSize = 0;
+
+/**
+ *  \brief reads a line of a text log file into <tt>line</tt>.
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file
+ */
+static int readTextLine (FILE *fic)
+{
+    return (getline (&line, &lineSize, fic) == -1) ? -1 : 0;
+}
+
+/**
+ *  \brief reads the remaining of the title line, the blank line and the column header of a text log file.
+ *
+ *  \return LOG_TEXT, upon success
+ *  \return -\c 1, if no column header is found
+ */
+static int readTextHeader (FILE *fic, int *p_nGroups, int *p_nWaiters, int *p_nChefs)
+{
+    char *tok;
+    int n, w, k;
+
+    while (readTextLine (fic) == 0) {
+        if (strstr (line, "RC") == NULL) {
+            continue;
+        }
+        n = w = k = 0;
+        for (tok = strtok (line, " \n"); tok != NULL; tok = strtok (NULL, " \n")) {
+            if (tok[0] == 'G') {
+                n += 1;
+            }
+            else if ((tok[0] == 'W') && ((tok[1] == 'T') || isdigit ((unsigned char) tok[1]))) {
+                w += 1;
+            }
+            else if ((tok[0] == 'C') && ((tok[1] == 'H') || isdigit ((unsigned char) tok[1]))) {
+                k += 1;
+            }
+        }
+        if ((n > LOG_MAXGROUPS) || (w < 1) || (w > MAXWAITERS) || (k < 1) || (k > MAXCHEFS)) {
+            return -1;
+        }
+        *p_nGroups = n;
+        *p_nWaiters = w;
+        *p_nChefs = k;
+        return LOG_TEXT;
+    }
+    return -1;
+}
+
+/**
+ *  \brief reads the next record of a text log file, skipping the lines that are not records.
+ *
+ *  Records without the sequence number and timestamp columns get both set to 0.
+ */
+static int readTextRecord (FILE *fic, int nGroups, LOG_RECORD *p_rec)
+{
+    char *p, *end;
+    size_t nCol = NCOLUMNS (nGroups, p_rec->nWaiters, p_rec->nChefs);                            /* number of columns */
+    long long *v = (long long *) workBuf ((nCol + 2) * sizeof (long long));                        /* column values */
+    size_t n, c, first;
+
+    while (readTextLine (fic) == 0) {
+        n = 0;
+        p = line;
+        for (;;) {
+            while (*p == ' ') p++;
+            if ((*p == '\n') || (*p == '\0') || (n == nCol + 2)) {
+                break;
+            }
+            if ((p[0] == '.') && ((p[1] == ' ') || (p[1] == '\n') || (p[1] == '\0'))) {
+                v[n++] = -1;
+                p += 1;
+                continue;
+            }
+            v[n] = strtoll (p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            n += 1;
+            p = end;
+        }
+        while (*p == ' ') p++;
+        if (((*p != '\n') && (*p != '\0')) || ((n != nCol) && (n != nCol + 2))) {
+            continue;                                                                              /* not a record */
+        }
+        first = n - nCol;
+        p_rec->seq = (first == 2) ? (unsigned int) v[0] : 0;
+        p_rec->ts = (first == 2) ? v[1] : 0;
+        p_rec->nGroups = nGroups;
+        for (c = 0; c < nCol; c++) {
+            setColumn (p_rec, c, (int) v[first + c]);
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ *  \brief Reading the header of a log file.
+ *
+ *  Text log files are recognized by the title line; the numbers of groups, waiters and chefs are taken from the
+ *  column header. Binary and delta files of version 1 have no number of waiters, and files of versions 1 and 2 no
+ *  number of chefs: they were written by a single one.
+ *
+ *  \param fic log file
+ *  \param p_nGroups pointer to the location where the number of groups is stored
+ *  \param p_nWaiters pointer to the location where the number of waiters is stored
+ *  \param p_nChefs pointer to the location where the number of chefs is stored
+ *
+ *  \return format of the file (LOG_TEXT, LOG_BINARY or LOG_DELTA), upon success
+ *  \return -\c 1, if the file is not a log file
+ */
+int readLogHeader (FILE *fic, int *p_nGroups, int *p_nWaiters, int *p_nChefs)
+{
+    char magic[8];                                                                     /* binary file identification */
+    unsigned int hdr[4] = { 0, 0, 1, 1 };                                                  /* binary file parameters */
+    int format;
+
+    if (fread (magic, 1, sizeof (magic), fic) != sizeof (magic)) {
+        return -1;
+    }
+    if (magic[0] == ' ') {
+        return readTextHeader (fic, p_nGroups, p_nWaiters, p_nChefs);
+    }
+    magic[sizeof (magic) - 1] = '\0';
+    if (strcmp (magic, LOG_MAGIC) == 0) {
+        format = LOG_BINARY;
+    }
+    else if (strcmp (magic, LOG_DELTA_MAGIC) == 0) {
+        format = LOG_DELTA;
+    }
+    else return -1;
+
+    if ((fread (hdr, sizeof (unsigned int), 2, fic) != 2) || (hdr[0] < 1) || (hdr[0] > LOG_VERSION) ||
+        (hdr[1] > LOG_MAXGROUPS)) {
+        return -1;
+    }
+    if ((hdr[0] > 1) && ((fread (&hdr[2], sizeof (unsigned int), 1, fic) != 1) || (hdr[2] < 1) ||
+                         (hdr[2] > MAXWAITERS))) {
+        return -1;
+    }
+    if ((hdr[0] > 2) && ((fread (&hdr[3], sizeof (unsigned int), 1, fic) != 1) || (hdr[3] < 1) ||
+                         (hdr[3] > MAXCHEFS))) {
+        return -1;
+    }
+    *p_nGroups = (int) hdr[1];
+    *p_nWaiters = (int) hdr[2];
+    *p_nChefs = (int) hdr[3];
+    return format;
+}
+
+/**
+ *  \brief reads the next record of a delta log file on top of the previous one.
+ */
+static int readDeltaRecord (FILE *fic, int nGroups, LOG_RECORD *p_rec)
+{
+    int c, nCol = NCOLUMNS (nGroups, p_rec->nWaiters, p_rec->nChefs);
+    unsigned char *mask = workBuf ((nCol + 7) / 8);
+    long long v;
+
+    p_rec->nGroups = nGroups;
+    if (getVarint (fic, &v) == -1) {
+        return -1;
+    }
+    p_rec->seq += v;
+    if ((getVarint (fic, &v) == -1) || (fread (mask, 1, (nCol + 7) / 8, fic) != (size_t) (nCol + 7) / 8)) {
+        return -1;
+    }
+    p_rec->ts += v;
+    for (c = 0; c < nCol; c++) {
+        if (mask[c / 8] & (1 << (c % 8))) {
+            if (getVarint (fic, &v) == -1) {
+                return -1;
+            }
+            setColumn (p_rec, c, (int) v);
+        }
+    }
+    return 0;
+}
+
+/**
+ *  \brief Reading the next record of a log file.
+ *
+ *  A delta record only carries the columns that changed: the remaining ones are kept from the record
+ *  previously read into <tt>p_rec</tt>, which must therefore be reused from one call to the next.
+ *  In a text log file, lines that are not records are skipped, and records without the sequence number
+ *  and timestamp columns get both set to 0.
+ *
+ *  \param fic log file
+ *  \param format format of the file (from the file header)
+ *  \param nGroups number of groups (from the file header)
+ *  \param p_rec pointer to the location where the record is stored (a record of nGroups groups and of the waiters and
+ *  chefs of the file)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file or on a truncated record
+ */
+int readLogRecord (FILE *fic, int format, int nGroups, LOG_RECORD *p_rec)
+{
+    unsigned char *buf, *p;
+    size_t size = countSize (nGroups), recSize = binRecordSize (nGroups, p_rec->nWaiters, p_rec->nChefs);
+    int g, k;
+
+    if (format == LOG_DELTA) {
+        return readDeltaRecord (fic, nGroups, p_rec);
+    }
+    if (format == LOG_TEXT) {
+        return readTextRecord (fic, nGroups, p_rec);
+    }
+
+    p = buf = workBuf (recSize);
+    if (fread (buf, 1, recSize, fic) != recSize) {
+        return -1;
+    }
+    memcpy (&p_rec->seq, p, 4);                 p += 4;
+    memcpy (&p_rec->ts, p, 8);                  p += 8;
+    for (k = 0; k < p_rec->nChefs; k++) {
+        p_rec->st.chefStat[k] = *p++;
+    }
+    for (k = 0; k < p_rec->nWaiters; k++) {
+        p_rec->st.waiterStat[k] = *p++;
+    }
+    p_rec->st.receptionistStat = *p++;
+    p_rec->groupsWaiting = getCount (p, size); p += size;
+    p_rec->nGroups = nGroups;
+    for (g = 0; g < nGroups; g++) {
+        recGroupStat (p_rec)[g] = *p++;
+    }
+    for (g = 0; g < nGroups; g++) {
+        recAssignedTable (p_rec)[g] = getCount (p, size);
+        p += size;
+    }
+    return 0;
+}
+
+/**
+ *  \brief Initialization of the reading of a log file in sequence order.
+ *
+ *  \param p_ro pointer to the read ahead records of the file
+ *  \param nGroups number of groups (from the file header)
+ *  \param nWaiters number of waiters (from the file header)
+ *  \param nChefs number of chefs (from the file header)
+ */
+void initLogReorder (LOG_REORDER *p_ro, int nGroups, int nWaiters, int nChefs)
+{
+    p_ro->rec = newLogRecord (nGroups, nWaiters, nChefs);
+    p_ro->heap = NULL;
+    p_ro->n = p_ro->size = 0;
+    p_ro->next = 0;
+    p_ro->eof = false;
+}
+
+/**
+ *  \brief Reading the next record of a log file in sequence order.
+ *
+ *  Records written out of order (see <tt>writeSnapshot</tt>) are held back until the ones with lower sequence
+ *  numbers have been read, up to LOG_REORDER_MAX records, beyond which a missing sequence number is given up.
+ *  Records without a sequence number are delivered in file order.
+ *
+ *  \param fic log file
+ *  \param format format of the file (from the file header)
+ *  \param nGroups number of groups (from the file header)
+ *  \param p_ro pointer to the read ahead records of the file
+ *  \param p_rec pointer to the location where the record is stored
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file or on a truncated record, once the records held back have been delivered
+ */
+int readLogRecordInOrder (FILE *fic, int format, int nGroups, LOG_REORDER *p_ro, LOG_RECORD *p_rec)
+{
+    LOG_RECORD **heap, *tmp;
+    int i, c, size;
+
+    for (;;) {
+        heap = p_ro->heap;
+        if ((p_ro->n > 0) && ((heap[0]->seq <= p_ro->next) || p_ro->eof || (p_ro->n == LOG_REORDER_MAX))) {
+            copyLogRecord (p_rec, heap[0]);                           /* take the lowest sequence number held back */
+            tmp = heap[0]; heap[0] = heap[--p_ro->n]; heap[p_ro->n] = tmp;
+            for (i = 0; (c = 2 * i + 1) < p_ro->n; i = c) {
+                if ((c + 1 < p_ro->n) && (heap[c + 1]->seq < heap[c]->seq)) {
+                    c += 1;
+                }
+                if (heap[i]->seq <= heap[c]->seq) {
+                    break;
+                }
+                tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+            }
+            break;
+        }
+        if (p_ro->eof) {
+            return -1;
+        }
+        if (readLogRecord (fic, format, nGroups, p_ro->rec) != 0) {
+            p_ro->eof = true;
+            continue;
+        }
+        if ((p_ro->n == 0) && (p_ro->rec->seq <= p_ro->next)) {
+            copyLogRecord (p_rec, p_ro->rec);                                                /* in order: no wait */
+            break;
         }
+
+        /* hold the record back; the slots beyond n keep the records already delivered, for reuse */
+        if (p_ro->n == p_ro->size) {
+            size = (2 * p_ro->size + 16 < LOG_REORDER_MAX) ? 2 * p_ro->size + 16 : LOG_REORDER_MAX;
+            if ((heap = realloc (heap, size * sizeof (LOG_RECORD *))) == NULL) {
+                perror ("error on allocating the records held back");
+                exit (EXIT_FAILURE);
+            }
+            for (i = p_ro->size; i < size; i++) {
+                heap[i] = newLogRecord (nGroups, p_ro->rec->nWaiters, p_ro->rec->nChefs);
+            }
+            p_ro->heap = heap;
+            p_ro->size = size;
+        }
+        copyLogRecord (heap[p_ro->n], p_ro->rec);
+        for (i = p_ro->n++; (i > 0) && (heap[(i - 1) / 2]->seq > heap[i]->seq); i = (i - 1) / 2) {
+            tmp = heap[i]; heap[i] = heap[(i - 1) / 2]; heap[(i - 1) / 2] = tmp;
+        }
+    }
+    if (p_rec->seq >= p_ro->next) {
+        p_ro->next = p_rec->seq + 1;
     }
+    return 0;
+}
+
+/**
+ *  \brief Printing the title line and the column header of the text format.
+ *
+ *  \param fic log file
+ *  \param nGroups number of groups
+ *  \param nWaiters number of waiters
+ *  \param nChefs number of chefs
+ *  \param stamped print the sequence number and timestamp columns
+ */
+void printLogTitle (FILE *fic, int nGroups, int nWaiters, int nChefs, bool stamped)
+{
+    char *title = (char *) workBuf (LOGTITLE_MAX (nGroups));
+
+    fwrite (title, 1, formatTitle (title, nGroups, nWaiters, nChefs, stamped), fic);
+}
+
+/**
+ *  \brief Printing a record as a line of the text format.
+ *
+ *  The following layout is obeyed for the full state in a single line
+ *    \li sequence number and time since the start of the simulation in ns (only if stamped)
+ *    \li state of each chef
+ *    \li state of each waiter
+ *    \li receptioninst state 
+ *    \li groups state 
+ *    \li table assigned to each group
+ *
+ *  \param fic log file
+ *  \param p_rec pointer to the record
+ *  \param stamped print the sequence number and timestamp columns
+ */
+void printLogRecord (FILE *fic, LOG_RECORD *p_rec, bool stamped)
+{
+    char *buf = (char *) workBuf (LOGREC_MAX (p_rec->nGroups));
+
+    fwrite (buf, 1, formatTextRecord (buf, p_rec, stamped), fic);
+}
 
+/** \brief appends a column of the filtered layout: the value, or "." if equal to the one of the previous record */
+static char *putField (char *p, int v, int width, bool same)
+{
+    if (same) {
+        memset (p, ' ', width - 1);
+        p += width - 1;
+        *p++ = '.';
+    }
+    else p = putInt (p, v, width);
+    *p++ = ' ';
+    return p;
+}
 
-    fprintf(fic,"\n");
+/**
+ *  \brief Printing the title line and the column header of the filtered layout.
+ *
+ *  The layout is the one of <tt>filter_log.awk</tt>: widths 3, 2 and 2 for the role states (3 for each chef, 2 for
+ *  each waiter), 3 for each group state, 4 for groupsWaiting and 3 for each assigned table, every column followed
+ *  by a space; group columns are as wide as the header of the last group with more than 100 groups.
+ *
+ *  \param fic log file
+ *  \param nGroups number of groups
+ *  \param nWaiters number of waiters
+ *  \param nChefs number of chefs
+ *  \param stamped print the sequence number and timestamp columns
+ */
+void printFilteredTitle (FILE *fic, int nGroups, int nWaiters, int nChefs, bool stamped)
+{
+    int w = groupWidth (nGroups) - 1;
+    char label[16];
+    int g, k;
 
-    closeLog(fic);
+    fprintf (fic, "%31cRestaurant - Description of the internal state\n\n", ' ');
+    if (stamped) {
+        fprintf (fic, "%*s %*s ", SEQ_WIDTH, "SEQ", TS_WIDTH, "TS(ns)");
+    }
+    for (k = 0; k < nChefs; k++) {
+        fprintf (fic, "%3s ", staffLabel (label, "CH", k, nChefs));
+    }
+    for (k = 0; k < nWaiters; k++) {
+        fprintf (fic, "%2s ", staffLabel (label, "WT", k, nWaiters));
+    }
+    fprintf (fic, "%2s ", "RC");
+    for (g = 0; g < nGroups; g++) {
+        sprintf (label, "G%02d", g);
+        fprintf (fic, "%*s ", w, label);
+    }
+    fprintf (fic, "%*s ", waitingWidth (nGroups) - 1, "gWT");
+    for (g = 0; g < nGroups; g++) {
+        sprintf (label, "T%02d", g);
+        fprintf (fic, "%*s ", w, label);
+    }
+    fprintf (fic, "\n");
 }
 
+/**
+ *  \brief Printing a record as a line of the filtered layout.
+ *
+ *  Role and group states equal to the ones of the previous record are replaced by a ".", as are the
+ *  groups without an assigned table.
+ *
+ *  \param fic log file
+ *  \param p_rec pointer to the record
+ *  \param p_prev pointer to the previous record (NULL for the first one)
+ *  \param stamped print the sequence number and timestamp columns
+ */
+void printFilteredRecord (FILE *fic, LOG_RECORD *p_rec, LOG_RECORD *p_prev, bool stamped)
+{
+    char *buf = (char *) workBuf (LOGREC_MAX (p_rec->nGroups));
+    char *p = buf;
+    int *stat = recGroupStat (p_rec), *table = recAssignedTable (p_rec);
+    int w = groupWidth (p_rec->nGroups) - 1;
+    int g, k;
+
+    if (stamped) {
+        p = putInt (p, p_rec->seq, SEQ_WIDTH);
+        *p++ = ' ';
+        p = putInt (p, p_rec->ts, TS_WIDTH);
+        *p++ = ' ';
+    }
+    for (k = 0; k < p_rec->nChefs; k++) {
+        p = putField (p, p_rec->st.chefStat[k], 3, p_prev && (p_prev->st.chefStat[k] == p_rec->st.chefStat[k]));
+    }
+    for (k = 0; k < p_rec->nWaiters; k++) {
+        p = putField (p, p_rec->st.waiterStat[k], 2, p_prev && (p_prev->st.waiterStat[k] == p_rec->st.waiterStat[k]));
+    }
+    p = putField (p, p_rec->st.receptionistStat, 2,
+                  p_prev && (p_prev->st.receptionistStat == p_rec->st.receptionistStat));
+    for (g = 0; g < p_rec->nGroups; g++) {
+        p = putField (p, stat[g], w, p_prev && (recGroupStat (p_prev)[g] == stat[g]));
+    }
+    p = putField (p, p_rec->groupsWaiting, waitingWidth (p_rec->nGroups) - 1, false);
+    for (g = 0; g < p_rec->nGroups; g++) {
+        p = putField (p, table[g], w, table[g] == -1);
+    }
+    *p++ = '\n';
+    fwrite (buf, 1, p - buf, fic);
+}
@@ -7,7 +7,11 @@
  *
  *  Defined operations:
  *     \li file initialization
- *     \li writing the present full state as a single line at the end of the file.
+ *     \li opening, flushing and closing a per-process logging session, optionally on a log segment of its own
+ *     \li writing the present full state as a single line at the end of the file
+ *     \li taking a snapshot of the state inside the critical region and writing it after leaving it
+ *     \li handing records over to a logger process through a ring buffer in shared memory
+ *     \li reading back and printing records of a log file, in the text or the filtered layout.
  *
  *  \author Nuno Lau - December 2023
  */
@@ -15,8 +19,206 @@
 #ifndef LOGGING_H_
 #define LOGGING_H_
 
+#include <stdio.h>
+#include <stdbool.h>
+
 #include "probDataStruct.h"
 
+/** \brief text log format: one line per record */
+#define  LOG_TEXT          0
+/** \brief binary log format: file header followed by fixed-size records */
+#define  LOG_BINARY        1
+/** \brief delta log format: file header followed by records holding only the columns that changed */
+#define  LOG_DELTA         2
+
+/** \brief magic string at the start of a binary log file */
+#define  LOG_MAGIC         "RSTLOG"
+/** \brief magic string at the start of a delta log file */
+#define  LOG_DELTA_MAGIC   "RSTLOGD"
+/**
+ *  \brief version of the binary log format (files of version 1 have no number of waiters and files of versions 1
+ *  and 2 no number of chefs: they were written by a single one)
+ */
+#define  LOG_VERSION       3
+
+/** \brief number of slots of the log ring buffer (power of 2), fewer if they would not fit in LOG_RING_BYTES */
+#define  LOG_RING_SIZE     1024
+/** \brief size the slots of the log ring buffer are kept within, unless that leaves fewer than LOG_RING_MIN */
+#define  LOG_RING_BYTES    (16 * 1024 * 1024)
+/** \brief minimum number of slots of the log ring buffer */
+#define  LOG_RING_MIN      16
+
+/** \brief ring overflow policy: producers wait for a free slot */
+#define  LOG_BLOCK         0
+/** \brief ring overflow policy: records that do not fit are dropped and counted */
+#define  LOG_DROP          1
+
+/** \brief polling period of the logger process when the ring is empty (us) */
+#define  LOG_DRAIN_PERIOD  200
+
+/** \brief records a reader may hold back while waiting for a missing sequence number */
+#define  LOG_REORDER_MAX   65536
+
+/**
+ *  \brief Definition of a log record, as stored in a binary log file.
+ *
+ *  The record is followed by the state of each group and the table used by each group (see <tt>recGroupStat</tt>
+ *  and <tt>recAssignedTable</tt>): it is allocated with <tt>newLogRecord</tt> and copied with <tt>copyLogRecord</tt>.
+ */
+typedef struct {
+    /** \brief sequence number */
+    unsigned int seq;
+    /** \brief time since the start of the simulation (ns) */
+    long long ts;
+    /** \brief state of the intervening roles */
+    STAT st;
+    /** \brief number of groups */
+    int nGroups;
+    /** \brief number of waiters (entries of st.waiterStat in use) */
+    int nWaiters;
+    /** \brief number of chefs (entries of st.chefStat in use) */
+    int nChefs;
+    /** \brief number of groups waiting for table */
+    int groupsWaiting;
+    /** \brief state of each group, then table that is being used by each group */
+    int group[];
+} LOG_RECORD;
+
+/**
+ *  \brief Definition of a slot of the log ring buffer (the slot is followed by its record).
+ */
+typedef struct {
+    /** \brief ring position the slot is ready for: pos when free, pos+1 when holding the record of position pos */
+    unsigned long long ticket;
+} LOG_SLOT;
+
+/**
+ *  \brief Definition of the log ring buffer (multiple producers, one consumer, lock free).
+ */
+typedef struct {
+    /** \brief records are handed to the logger process instead of being written by the producers */
+    int enabled;
+    /** \brief overflow policy (LOG_BLOCK or LOG_DROP) */
+    int overflow;
+    /** \brief set when no more records will be produced */
+    int done;
+    /** \brief set when the logger process terminated early: producers drop records instead of waiting */
+    int abandoned;
+    /** \brief number of records dropped because the ring was full */
+    unsigned int dropped;
+    /** \brief number of slots (power of 2) */
+    unsigned int size;
+    /** \brief next position to be claimed by a producer */
+    _Alignas(CACHE_LINE) unsigned long long head;
+    /** \brief next position to be read by the consumer */
+    _Alignas(CACHE_LINE) unsigned long long tail;
+} LOG_RING;
+
+/**
+ *  \brief Definition of the logging control data, shared by all processes.
+ *
+ *  The reference record of the delta format and the slots of the ring buffer, whose size depends on the number
+ *  of groups, follow the control data in memory (see <tt>setLogCtlData</tt>) and are located by their offsets
+ *  from its start.
+ */
+typedef struct {
+    /** \brief log format (LOG_TEXT, LOG_BINARY or LOG_DELTA) */
+    int format;
+    /** \brief text records start with a sequence number and a timestamp column */
+    int stamped;
+    /** \brief each process writes its records to its own binary log segment */
+    int perProcess;
+    /** \brief sampling period of the monitor process (us, 0 if there is no monitor) */
+    int samplePeriod;
+    /** \brief set when the monitor process must take its last sample and terminate */
+    int sampleDone;
+    /** \brief number of groups of the records */
+    int nGroups;
+    /** \brief sequence number of the next record */
+    _Alignas(CACHE_LINE) unsigned int seq;
+    /** \brief sequence number of the next record to be written, when records must reach the file in sequence order
+     *  (futex word the writers sleep on) */
+    unsigned int written;
+    /** \brief monotonic clock at the start of the simulation (ns) */
+    long long t0;
+    /** \brief offset of the last record written, reference of the next delta record */
+    size_t lastOff;
+    /** \brief set when the last record written is kept */
+    int hasLast;
+    /** \brief offset of the slots of the ring buffer */
+    size_t slotOff;
+    /** \brief size of a slot of the ring buffer, record included (a whole number of cache lines) */
+    size_t slotSize;
+    /** \brief ring buffer used to hand records to the logger process */
+    LOG_RING ring;
+} LOG_CTL;
+
+/**
+ *  \brief Definition of the records of a log file read ahead to be delivered in sequence order.
+ */
+typedef struct {
+    /** \brief record the file is read into (a delta record is decoded from the previous one) */
+    LOG_RECORD *rec;
+    /** \brief records held back, in a heap ordered by sequence number */
+    LOG_RECORD **heap;
+    /** \brief number of records held back */
+    int n;
+    /** \brief number of records the heap has room for */
+    int size;
+    /** \brief sequence number of the next record to deliver */
+    unsigned int next;
+    /** \brief set at end of file */
+    bool eof;
+} LOG_REORDER;
+
+/** \brief state of each group in a record */
+static inline int *recGroupStat (LOG_RECORD *p_rec)
+{
+    return p_rec->group;
+}
+
+/** \brief table that is being used by each group in a record (-1 if none) */
+static inline int *recAssignedTable (LOG_RECORD *p_rec)
+{
+    return p_rec->group + p_rec->nGroups;
+}
+
+/**
+ *  \brief Size of a record of nGroups groups (bytes).
+ */
+extern size_t logRecordSize (int nGroups);
+
+/**
+ *  \brief Allocation of a record of nGroups groups, nWaiters waiters and nChefs chefs, all its columns set to 0.
+ *
+ *  \return pointer to the record (the process exits if there is no memory left)
+ */
+extern LOG_RECORD *newLogRecord (int nGroups, int nWaiters, int nChefs);
+
+/**
+ *  \brief Copy of a record onto a record of the same number of groups.
+ */
+extern void copyLogRecord (LOG_RECORD *p_dst, LOG_RECORD *p_src);
+
+/**
+ *  \brief Size of the data that follows the logging control data for nGroups groups (bytes).
+ *
+ *  \param nGroups number of groups
+ *  \param ring room is made for the slots of the log ring buffer
+ */
+extern size_t logCtlDataSize (int nGroups, bool ring);
+
+/**
+ *  \brief Location of the data of the logging control data in the logCtlDataSize bytes at p_data (aligned on a
+ *  cache line, after the control data).
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ *  \param p_data pointer to the data
+ *  \param nGroups number of groups
+ *  \param ring the data has room for the slots of the log ring buffer
+ */
+extern void setLogCtlData (LOG_CTL *p_ctl, void *p_data, int nGroups, bool ring);
+
 /**
  *  \brief File initialization.
  *
@@ -27,10 +229,37 @@
  *       \li a title line
  *       \li a blank line.
  *
+ *  In binary and delta formats, the header is a <tt>LOG_MAGIC</tt> or <tt>LOG_DELTA_MAGIC</tt> tag followed by
+ *  the format version, the number of groups, the number of waiters and the number of chefs.
+ *
  *  \param nFic name of the logging file
  */
 extern void createLog (char nFic[], FULL_STAT *p_fSt);
 
+/**
+ *  \brief Opening of the logging session of the calling process.
+ *
+ *  The logging file is opened once and kept open until <tt>closeLogSession</tt> is called.
+ *  If <tt>nFic</tt> is a null pointer or a null string, stdout is used.
+ *  In per-process mode, the records go to the binary log segment <tt>nFic_tag</tt> instead; the segments
+ *  of a run are merged back in sequence order by <tt>restaurantlog</tt>.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_ctl pointer to the shared logging control data (NULL for text records without sequence numbers)
+ *  \param tag name of the calling entity, as in its error file (GR00, WT, CH, RT, ...)
+ */
+extern void openLogSession (char nFic[], LOG_CTL *p_ctl, char tag[]);
+
+/**
+ *  \brief Flushing of the records buffered by the logging session.
+ */
+extern void flushLog (void);
+
+/**
+ *  \brief Closing of the logging session of the calling process.
+ */
+extern void closeLogSession (void);
+
 /**
  *  \brief write a log record (complete line) that includes the state of all entities and more info.
  *
@@ -41,4 +270,184 @@ extern void createLog (char nFic[], FULL_STAT *p_fSt);
  */
 extern void saveState (char nFic[], FULL_STAT *p_fSt);
 
+/**
+ *  \brief Taking a snapshot of the present full state.
+ *
+ *  To be called inside the critical region: the state is copied and tagged with the next sequence number,
+ *  so that formatting and file I/O can be done by <tt>writeSnapshot</tt> after leaving it.
+ *  When the log ring buffer is enabled, the snapshot is copied straight into the ring.
+ *
+ *  \param p_rec pointer to the location where the snapshot is stored
+ *  \param p_fSt pointer to the location where the full internal state of the problem is stored
+ */
+extern void snapshotState (LOG_RECORD *p_rec, FULL_STAT *p_fSt);
+
+/**
+ *  \brief Writing a snapshot taken by <tt>snapshotState</tt>.
+ *
+ *  To be called right after leaving the critical region, before any blocking operation. Binary records and
+ *  stamped text records are written straight away, in any order: they carry their sequence number, and
+ *  readers put them back in order (see <tt>readLogRecordInOrder</tt>). Plain text and delta records must
+ *  reach the file in sequence order, so the writer sleeps until the snapshots taken before its own are written.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_rec pointer to the snapshot
+ */
+extern void writeSnapshot (char nFic[], LOG_RECORD *p_rec);
+
+/**
+ *  \brief Initialization of the log ring buffer.
+ *
+ *  From then on, <tt>saveState</tt> only copies records into the ring; a logger process running
+ *  <tt>drainLogRing</tt> formats them and writes them to the logging file.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ *  \param overflow overflow policy (LOG_BLOCK or LOG_DROP)
+ */
+extern void createLogRing (LOG_CTL *p_ctl, int overflow);
+
+/**
+ *  \brief Signalling the logger process that no more records will be produced.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ */
+extern void closeLogRing (LOG_CTL *p_ctl);
+
+/**
+ *  \brief Signalling the producers that the logger process terminated early.
+ *
+ *  From then on, records that do not fit in the ring are dropped and counted, whatever the overflow policy.
+ *
+ *  \param p_ctl pointer to the shared logging control data
+ */
+extern void abandonLogRing (LOG_CTL *p_ctl);
+
+/**
+ *  \brief Life cycle of the logger process.
+ *
+ *  Records are taken out of the ring in production order and written to the logging file until
+ *  <tt>closeLogRing</tt> is called and the ring is empty.
+ *
+ *  \param nFic name of the logging file
+ *  \param p_ctl pointer to the shared logging control data
+ *
+ *  \return number of records written
+ */
+extern unsigned long drainLogRing (char nFic[], LOG_CTL *p_ctl);
+
+/**
+ *  \brief Reading the header of a log file.
+ *
+ *  Text log files are recognized by the title line; the numbers of groups, waiters and chefs are taken from the
+ *  column header.
+ *
+ *  \param fic log file
+ *  \param p_nGroups pointer to the location where the number of groups is stored
+ *  \param p_nWaiters pointer to the location where the number of waiters is stored
+ *  \param p_nChefs pointer to the location where the number of chefs is stored
+ *
+ *  \return format of the file (LOG_TEXT, LOG_BINARY or LOG_DELTA), upon success
+ *  \return -\c 1, if the file is not a log file
+ */
+extern int readLogHeader (FILE *fic, int *p_nGroups, int *p_nWaiters, int *p_nChefs);
+
+/**
+ *  \brief Reading the next record of a log file.
+ *
+ *  A delta record only carries the columns that changed: the remaining ones are kept from the record
+ *  previously read into <tt>p_rec</tt>, which must therefore be reused from one call to the next.
+ *  In a text log file, lines that are not records are skipped, and records without the sequence number
+ *  and timestamp columns get both set to 0.
+ *
+ *  \param fic log file
+ *  \param format format of the file (from the file header)
+ *  \param nGroups number of groups (from the file header)
+ *  \param p_rec pointer to the location where the record is stored (a record of the groups, waiters and chefs of
+ *  the file)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file or on a truncated record
+ */
+extern int readLogRecord (FILE *fic, int format, int nGroups, LOG_RECORD *p_rec);
+
+/**
+ *  \brief Initialization of the reading of a log file in sequence order.
+ *
+ *  \param p_ro pointer to the read ahead records of the file
+ *  \param nGroups number of groups (from the file header)
+ *  \param nWaiters number of waiters (from the file header)
+ *  \param nChefs number of chefs (from the file header)
+ */
+extern void initLogReorder (LOG_REORDER *p_ro, int nGroups, int nWaiters, int nChefs);
+
+/**
+ *  \brief Reading the next record of a log file in sequence order.
+ *
+ *  Records written out of order (see <tt>writeSnapshot</tt>) are held back until the ones with lower sequence
+ *  numbers have been read, up to LOG_REORDER_MAX records, beyond which a missing sequence number is given up.
+ *  Records without a sequence number are delivered in file order.
+ *
+ *  \param fic log file
+ *  \param format format of the file (from the file header)
+ *  \param nGroups number of groups (from the file header)
+ *  \param p_ro pointer to the read ahead records of the file
+ *  \param p_rec pointer to the location where the record is stored
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file or on a truncated record, once the records held back have been delivered
+ */
+extern int readLogRecordInOrder (FILE *fic, int format, int nGroups, LOG_REORDER *p_ro, LOG_RECORD *p_rec);
+
+/**
+ *  \brief Printing the title line and the column header of the text format.
+ *
+ *  \param fic log file
+ *  \param nGroups number of groups
+ *  \param nWaiters number of waiters
+ *  \param nChefs number of chefs
+ *  \param stamped print the sequence number and timestamp columns
+ */
+extern void printLogTitle (FILE *fic, int nGroups, int nWaiters, int nChefs, bool stamped);
+
+/**
+ *  \brief Printing a record as a line of the text format.
+ *
+ *  \param fic log file
+ *  \param p_rec pointer to the record
+ *  \param stamped print the sequence number and timestamp columns
+ */
+extern void printLogRecord (FILE *fic, LOG_RECORD *p_rec, bool stamped);
+
+/**
+ *  \brief Printing the title line and the column header of the filtered layout.
+ *
+ *  \param fic log file
+ *  \param nGroups number of groups
+ *  \param nWaiters number of waiters
+ *  \param nChefs number of chefs
+ *  \param stamped print the sequence number and timestamp columns
+ */
+extern void printFilteredTitle (FILE *fic, int nGroups, int nWaiters, int nChefs, bool stamped);
+
+/**
+ *  \brief Printing a record as a line of the filtered layout.
+ *
+ *  \param fic log file
+ *  \param p_rec pointer to the record
+ *  \param p_prev pointer to the previous record (NULL for the first one)
+ *  \param stamped print the sequence number and timestamp columns
+ */
+extern void printFilteredRecord (FILE *fic, LOG_RECORD *p_rec, LOG_RECORD *p_prev, bool stamped);
+
+/*
+ *  In sampling mode (compiled with -DLOG_SAMPLING, see the <tt>sampling</tt> target of the Makefile), the
+ *  state trajectory is kept by the monitor process alone: the per-transition logging calls of the intervening
+ *  entities compile to nothing. Only the units that write samples define LOG_SAMPLER before this file.
+ */
+#if defined (LOG_SAMPLING) && !defined (LOG_SAMPLER)
+#define  saveState(nFic, p_fSt)            ((void) 0)
+#define  snapshotState(p_rec, p_fSt)       ((void) (p_rec))
+#define  writeSnapshot(nFic, p_rec)        ((void) 0)
+#endif
+
 #endif /* LOGGING_H_ */
@@ -13,10 +13,16 @@
 
 /* Generic parameters */
 
-/** \brief maximum number of groups */
-#define  MAXGROUPS       16 
-/** \brief number of tables */
+/** \brief number of tables, unless config.txt gives it */
 #define  NUMTABLES        2 
+/** \brief number of waiters, unless config.txt gives it */
+#define  NUMWAITERS       1
+/** \brief maximum number of waiters */
+#define  MAXWAITERS       8
+/** \brief number of chefs, unless config.txt gives it */
+#define  NUMCHEFS         1
+/** \brief maximum number of chefs */
+#define  MAXCHEFS         8
 /** \brief controls time taken to cook */
 #define  MAXCOOK        100
 
@@ -14,9 +14,13 @@
 #define PROBDATASTRUCT_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "probConst.h"
 
+/** \brief size of a cache line (bytes): data written by different processes is kept in different lines */
+#define  CACHE_LINE     64
+
 /**
  *  \brief Definition of requests to receptionist and waiter 
  */
@@ -29,55 +33,109 @@ typedef struct {
 
 
 /**
- *  \brief Definition of <em>state of the intervening entities</em> data type.
+ *  \brief Definition of <em>state of the intervening roles</em> data type (the state of each group is kept in
+ *  a runtime-sized array of the full state).
  */
 typedef struct {
     /** \brief receptionist state */
     unsigned int receptionistStat;
-    /** \brief waiter state */
-    unsigned int waiterStat;
-    /** \brief chef state */
-    unsigned int chefStat;
-    /** \brief group state array */
-    unsigned int groupStat[MAXGROUPS];
+    /** \brief state of each waiter (only the first nWaiters entries are used) */
+    unsigned int waiterStat[MAXWAITERS];
+    /** \brief state of each chef (only the first nChefs entries are used) */
+    unsigned int chefStat[MAXCHEFS];
 
 } STAT;
 
 
 /**
  *  \brief Definition of <em>full state of the problem</em> data type.
+ *
+ *  The state changed in the critical region, the request channel of the receptionist and the configuration (read
+ *  only once the simulation starts) start on cache lines of their own, so that a process posting a request or
+ *  reading the configuration does not invalidate the lines the others are working on.
+ *
+ *  The arrays with one entry per group are sized at run time, from the number of groups in config.txt: they
+ *  follow the full state in memory (see <tt>setFullStatData</tt>), each one on cache lines of its own, and are
+ *  located by their offsets from the start of the full state, which hold in the address space of any process.
  */
 typedef struct
-{   /** \brief state of all intervening entities */
-    STAT st;
+{   /** \brief state of all intervening roles */
+    _Alignas(CACHE_LINE) STAT st;
 
-    /** \brief number of groups */
-    int nGroups;
     /** \brief number of groups waiting for table */
     int groupsWaiting;
 
-    /** \brief estimated start time of groups */
-    int startTime[MAXGROUPS];
-    /** \brief estimated eat time of groups */
-    int eatTime[MAXGROUPS];
-
-    /** \brief saves the table that is being used by each group */
-    int assignedTable[MAXGROUPS];
-
-    /** \brief flag of food request from waiter to chef */
-    int foodOrder;
-    /** \brief group associated to food request from waiter to chef */
-    int foodGroup;
-
-
     /** \brief used by groups to store request to receptionist */
-    request receptionistRequest;
-
-    /** \brief used by groups and chef to store request to waiter */
-    request waiterRequest;
+    _Alignas(CACHE_LINE) request receptionistRequest;
 
+    /** \brief number of groups */
+    _Alignas(CACHE_LINE) int nGroups;
+    /** \brief number of tables */
+    int nTables;
+    /** \brief number of waiters */
+    int nWaiters;
+    /** \brief number of chefs */
+    int nChefs;
+
+    /** \brief offset of the state of each group (changed in the critical region) */
+    size_t groupStatOff;
+    /** \brief offset of the table that is being used by each group (changed in the critical region) */
+    size_t assignedTableOff;
+    /** \brief offset of the estimated start time of each group */
+    size_t startTimeOff;
+    /** \brief offset of the estimated eat time of each group */
+    size_t eatTimeOff;
 
 } FULL_STAT;
 
+/** \brief rounds a size up to a whole number of cache lines */
+#define  CACHE_ROUND(n)  (((n) + CACHE_LINE - 1) & ~((size_t) CACHE_LINE - 1))
+
+/** \brief state of each group */
+static inline unsigned int *groupStat (FULL_STAT *p_fSt)
+{
+    return (unsigned int *) ((char *) p_fSt + p_fSt->groupStatOff);
+}
+
+/** \brief table that is being used by each group (-1 if none) */
+static inline int *assignedTable (FULL_STAT *p_fSt)
+{
+    return (int *) ((char *) p_fSt + p_fSt->assignedTableOff);
+}
+
+/** \brief estimated start time of each group */
+static inline int *startTime (FULL_STAT *p_fSt)
+{
+    return (int *) ((char *) p_fSt + p_fSt->startTimeOff);
+}
+
+/** \brief estimated eat time of each group */
+static inline int *eatTime (FULL_STAT *p_fSt)
+{
+    return (int *) ((char *) p_fSt + p_fSt->eatTimeOff);
+}
+
+/** \brief size of the runtime-sized arrays of the full state for nGroups groups (bytes) */
+static inline size_t fullStatDataSize (int nGroups)
+{
+    return 4 * CACHE_ROUND (nGroups * sizeof (int));
+}
+
+/**
+ *  \brief locates the runtime-sized arrays of the full state in the fullStatDataSize bytes at p_data
+ *  (aligned on a cache line, after the full state), and sets the number of groups.
+ */
+static inline void setFullStatData (FULL_STAT *p_fSt, void *p_data, int nGroups)
+{
+    size_t off = (char *) p_data - (char *) p_fSt,                                           /* offset of next array */
+           len = CACHE_ROUND (nGroups * sizeof (int));                                          /* size of each array */
+
+    p_fSt->nGroups = nGroups;
+    p_fSt->groupStatOff = off;
+    p_fSt->assignedTableOff = off + len;
+    p_fSt->startTimeOff = off + 2 * len;
+    p_fSt->eatTimeOff = off + 3 * len;
+}
+
 
 #endif /* PROBDATASTRUCT_H_ */
@@ -11,6 +11,29 @@
  *  Upon execution, one parameter is requested:
  *    \li name of the logging file.
  *
+ *  The following options are accepted before it:
+ *    \li <tt>-b</tt>: write the log in binary format (to be decoded with <tt>restaurantlog</tt>)
+ *    \li <tt>-d</tt>: write the log in delta format, only the columns that changed (to be decoded with
+ *        <tt>restaurantlog</tt>)
+ *    \li <tt>-t</tt>: start each line of a text log with the record sequence number and its monotonic
+ *        timestamp in ns since the start of the simulation (binary and delta records always carry them); binary
+ *        and stamped text records are written as each process leaves the critical region, so they may reach the
+ *        file out of order: <tt>loganalyze</tt> and <tt>restaurantlog</tt> put them back in sequence order
+ *    \li <tt>-r block|drop</tt>: hand the records to a logger process through a ring buffer in shared memory;
+ *        when the ring is full, producers either wait for a free slot or drop the record.
+ *    \li <tt>-p</tt>: every process writes its records to a binary log segment of its own, named after the log
+ *        file and the process (<tt>log_GR00</tt>, <tt>log_WT00</tt>, <tt>log_CH00</tt>, ..., <tt>log_PR</tt> for
+ *        this process); the segments are merged back in sequence order with <tt>restaurantlog log_*</tt>.
+ *    \li <tt>-s period</tt>: start a monitor process that samples the full state every <tt>period</tt> us; when
+ *        built with <tt>make sampling</tt>, the entities log nothing themselves and the monitor always runs
+ *        (every <tt>SAMPLE_PERIOD</tt> us by default).
+ *    \li <tt>-c</tt>: the entities record the contention statistics of each semaphore (downs, downs that
+ *        blocked, total and maximum blocked time), reported at the end sorted by total blocked time, followed by
+ *        the number of adaptive downs on the mutex that were uncontended, completed while spinning or blocked.
+ *    \li <tt>-w deadline</tt>: watchdog; if the entities have not finished <tt>deadline</tt> seconds after the start
+ *        of operations, report the semaphore each one is blocked on, kill them all, destroy the semaphore set and
+ *        the shared region and exit with EXIT_FAILURE.
+ *
  *  \author Nuno Lau - December 2023
  */
 
@@ -18,11 +41,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #include "probConst.h"
 #include "probDataStruct.h"
@@ -42,6 +68,147 @@
 
 /** \brief name of chef process */
 #define   RECEPTIONIST       "./receptionist"
+
+/** \brief name of logger process */
+#define   LOGGER             "./logger"
+
+/** \brief name of monitor process */
+#define   MONITOR            "./monitor"
+
+/** \brief default sampling period of the monitor process when built for sampling (us) */
+#define   SAMPLE_PERIOD      1000
+
+/** \brief period the watchdog checks the logger process is still running with (ms) */
+#define   LOGGER_CHECK       100
+
+/**
+ *  \brief name of semaphore sindex of the set, for the watchdog report.
+ */
+static void semName (SHARED_DATA *sh, unsigned int sindex, char *name)
+{
+    if (sindex == MUTEX) strcpy (name, "mutex");
+    else if (sindex == RECEPTIONISTREQ) strcpy (name, "receptionistReq");
+    else if (sindex == RECEPTIONISTREQUESTPOSSIBLE) strcpy (name, "receptionistRequestPossible");
+    else if (sindex == WAITERREQUEST) strcpy (name, "waiterRequest");
+    else if (sindex == WAITORDER) strcpy (name, "waitOrder");
+    else if (sindex == sh->rolesDone) strcpy (name, "rolesDone");
+    else if (sindex >= waitForTable (sh, 0)) sprintf (name, "waitForTable[%u]", sindex - waitForTable (sh, 0));
+    else if (sindex % SEMSET_ALIGN == foodArrived (sh, 0) % SEMSET_ALIGN)
+        sprintf (name, "foodArrived[%u]", (sindex - TABLESEMS) / SEMSET_ALIGN);
+    else if (sindex % SEMSET_ALIGN == requestReceived (sh, 0) % SEMSET_ALIGN)
+        sprintf (name, "requestReceived[%u]", (sindex - TABLESEMS) / SEMSET_ALIGN);
+    else sprintf (name, "tableDone[%u]", (sindex - TABLESEMS) / SEMSET_ALIGN);
+}
+
+/**
+ *  \brief reports the semaphore an entity is blocked on.
+ */
+static void reportEntity (SHARED_DATA *sh, char *entity, int pid, unsigned int sindex)
+{
+    char name[48];
+
+    if (waitpid (pid, NULL, WNOHANG) == pid) {
+        fprintf (stderr, "  %-4s (pid %d) finished\n", entity, pid);
+        return;
+    }
+    if (sindex == 0) {
+        fprintf (stderr, "  %-4s (pid %d) not blocked on a semaphore\n", entity, pid);
+        return;
+    }
+    semName (sh, sindex, name);
+    fprintf (stderr, "  %-4s (pid %d) blocked on semaphore %u (%s)\n", entity, pid, sindex, name);
+}
+
+/**
+ *  \brief reports the contention statistics of the semaphores, sorted by decreasing total blocked time.
+ */
+static void reportContention (SHARED_DATA *sh)
+{
+    unsigned int *order;                                                  /* semaphore locations in report order */
+    unsigned int n = semNu (sh), i, j, k;
+    char name[48];
+    SEMSTAT *st;
+
+    if ((order = malloc (n * sizeof (unsigned int))) == NULL) {
+        perror ("error on allocating the contention report");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < n; i++) {
+        k = i + 1;
+        for (j = i; (j > 0) && (semStat (sh)[order[j-1]].blockedNs < semStat (sh)[k].blockedNs); j--) {
+            order[j] = order[j-1];
+        }
+        order[j] = k;
+    }
+    fprintf (stderr, "%-28s %10s %10s %8s %12s %10s %10s\n",
+             "semaphore", "downs", "blocked", "blocked%", "total ms", "max ms", "mean us");
+    for (i = 0; i < n; i++) {
+        st = &semStat (sh)[order[i]];
+        if (st->nDown == 0) {
+            continue;
+        }
+        semName (sh, order[i], name);
+        fprintf (stderr, "%-28s %10lu %10lu %7.1f%% %12.3f %10.3f %10.1f\n", name, st->nDown, st->nBlocked,
+                 100.0 * st->nBlocked / st->nDown, st->blockedNs / 1e6, st->maxBlockedNs / 1e6,
+                 (st->nBlocked > 0) ? st->blockedNs / (1e3 * st->nBlocked) : 0.0);
+    }
+    free (order);
+}
+
+/**
+ *  \brief reports the early termination of the logger process and lets the producers drop the records it will
+ *  never take out of the ring.
+ */
+static void loggerLost (SHARED_DATA *sh, int status)
+{
+    abandonLogRing (&sh->logCtl);
+    if (WIFSIGNALED (status)) {
+        fprintf (stderr, "logger process killed by signal %d: the log is incomplete\n", WTERMSIG (status));
+    }
+    else fprintf (stderr, "logger process exited with status %d: the log is incomplete\n", WEXITSTATUS (status));
+}
+
+/**
+ *  \brief waits for the end of the life cycle of the entities during at most deadline seconds.
+ *
+ *  Meanwhile, the logger process, if any, is checked every LOGGER_CHECK ms: if it terminated, it is reaped and
+ *  <tt>*p_pidLG</tt> is set to -1.
+ *
+ *  \return true, if all of them finished; false, if the deadline expired
+ */
+static bool waitRoles (SHARED_DATA *sh, int semgid, unsigned int deadline, int *p_pidLG)
+{
+    struct timespec now;
+    long long tEnd, left, slice;                                                                         /* in ms */
+    int m, status;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    tEnd = (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000 + deadline * 1000LL;
+    m = 0;
+    while (m < 1 + sh->fSt.nChefs + sh->fSt.nWaiters + sh->fSt.nGroups) {
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        left = tEnd - ((long long) now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        if (left < 0) {
+            left = 0;
+        }
+        slice = ((*p_pidLG != -1) && (left > LOGGER_CHECK)) ? LOGGER_CHECK : left;
+        if (semDownTimed (semgid, sh->rolesDone, (unsigned int) slice) == 0) {
+            m += 1;
+        }
+        else if (errno != EAGAIN) {
+            perror ("error on waiting for the end of the intervening processes");
+            exit (EXIT_FAILURE);
+        }
+        else if (slice == left) {
+            return false;
+        }
+        else if (waitpid (*p_pidLG, &status, WNOHANG) == *p_pidLG) {
+            loggerLost (sh, status);
+            *p_pidLG = -1;
+        }
+    }
+    return true;
+}
 /**
  *  \brief Main program.
  *
@@ -51,26 +218,92 @@
 int main (int argc, char *argv[])
 {
     char nFic[51];                                                                              /*name of logging file */
-    char nFicErr[] = "error_        ";                                                     /* base name of error files */
+    char nFicErr[] = "error_              ";                                               /* base name of error files */
     int shmid,                                                                      /* shared memory access identifier */
         semgid;                                                                     /* semaphore set access identifier */
     unsigned int  m;                                                                             /* counting variables */
     SHARED_DATA *sh;                                                                /* pointer to shared memory region */
-    int pidCH,                                                                             /* pilot process identifier */
-        pidWT,                                                                     /* hostess process identifier array */
+    int pidCH[MAXCHEFS],                                                         /* chef process identifier array */
+        pidWT[MAXWAITERS],                                                         /* waiter process identifier array */
         pidRT,                                                                     /* hostess process identifier array */
-        pidGR[MAXGROUPS];                                                     /* passengers processes identifier array */
+        *pidGR,                                                               /* passengers processes identifier array */
+        pidLG = -1,                                                                       /* logger process identifier */
+        pidMN = -1;                                                                      /* monitor process identifier */
     int key;                                                           /*access key to shared memory and semaphore set */
     char num[2][12];                                                     /* numeric value conversion (up to 10 digits) */
     int status,                                                                                    /* execution status */
         info;                                                                                               /* info id */
-    int g, t;
+    bool logLost;                                                        /* the logger process terminated early */
+    int g, w, c,
+        nGroups, nTables, nWaiters, nChefs,                         /* number of groups, tables, waiters and chefs */
+        val;                                                                           /* value of a config section */
+    int opt,                                                                                /* command line option */
+        logFormat = LOG_TEXT,                                                                           /* log format */
+        logStamped = 0,                                                /* text records carry seq and timestamp */
+        logPerProcess = 0,                                            /* each process writes its own log segment */
+        semStatsOn = 0,                                             /* record semaphore contention statistics */
+#ifdef LOG_SAMPLING
+        samplePeriod = SAMPLE_PERIOD,                                             /* monitor sampling period (us) */
+#else
+        samplePeriod = 0,                                          /* monitor sampling period (us, 0 if no monitor) */
+#endif
+        logRing = -1,                                            /* log ring overflow policy (-1 if ring not used) */
+        watchdog = 0;                                                   /* watchdog deadline (s, 0 if no watchdog) */
+    char tag[16],                                                                   /* name of an entity in reports */
+         section[16];                                                                /* name of a config section */
+    struct timespec now;                                                                         /* start of simulation */
 
-    /* getting log file name */
-    if(argc==2) {
-        strcpy(nFic, argv[1]);
+    /* getting options and log file name */
+    while ((opt = getopt (argc, argv, "bdtpcs:r:w:")) != -1) {
+        switch (opt) {
+            case 'b':
+                logFormat = LOG_BINARY;
+                break;
+            case 'd':
+                logFormat = LOG_DELTA;
+                break;
+            case 't':
+                logStamped = 1;
+                break;
+            case 'p':
+                logPerProcess = 1;
+                break;
+            case 'c':
+                semStatsOn = 1;
+                break;
+            case 'r':
+                if (strcmp (optarg, "block") == 0) {
+                    logRing = LOG_BLOCK;
+                    break;
+                }
+                if (strcmp (optarg, "drop") == 0) {
+                    logRing = LOG_DROP;
+                    break;
+                }
+                /* fall through */
+            case 's':
+                if ((opt == 's') && ((samplePeriod = atoi (optarg)) > 0)) {
+                    break;
+                }
+                /* fall through */
+            case 'w':
+                if ((opt == 'w') && ((watchdog = atoi (optarg)) > 0)) {
+                    break;
+                }
+                /* fall through */
+            default:
+                fprintf (stderr, "USAGE: %s [-b|-d] [-t] [-r block|drop | -p] [-s period] [-c] [-w deadline] [log-file]\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+    if(argc-optind==1) {
+        strcpy(nFic, argv[optind]);
     }
     else strcpy(nFic, "");
+    if (logPerProcess && ((logRing != -1) || (logFormat != LOG_TEXT) || (strlen (nFic) == 0))) {
+        fprintf (stderr, "Log segments (-p) are binary, need a log file name and no logger process!\n");
+        exit (EXIT_FAILURE);
+    }
 
     /* composing command line */
     if ((key = ftok (".", 'a')) == -1) {
@@ -79,8 +312,47 @@ int main (int argc, char *argv[])
     }
     sprintf (num[1], "%d", key);
 
+    FILE *fp = fopen("config.txt","r");
+    if(fp==NULL) {
+        perror("Could not open config file");
+        exit(EXIT_FAILURE);
+    }
+
+    /* parse config file: number of groups and, optionally, "#ntables", "#nwaiters" and "#nchefs" lines followed by
+       the number of tables, of waiters and of chefs */
+    nTables = NUMTABLES;
+    nWaiters = NUMWAITERS;
+    nChefs = NUMCHEFS;
+    fscanf(fp,"%*[^\n]");
+    if ((fscanf(fp,"%d ",&nGroups) != 1) || (nGroups < 1)) {
+        fprintf (stderr, "Wrong number of groups in config file!\n");
+        exit (EXIT_FAILURE);
+    }
+    while (fscanf(fp,"#n%15[a-z] %d ",section,&val) == 2) {
+        if (strcmp (section, "tables") == 0) nTables = val;
+        else if (strcmp (section, "waiters") == 0) nWaiters = val;
+        else if (strcmp (section, "chefs") == 0) nChefs = val;
+        else {
+            fprintf (stderr, "Unknown section #n%s in config file!\n", section);
+            exit (EXIT_FAILURE);
+        }
+    }
+    if (nTables < 1) {
+        fprintf (stderr, "Wrong number of tables in config file!\n");
+        exit (EXIT_FAILURE);
+    }
+    if ((nWaiters < 1) || (nWaiters > MAXWAITERS)) {
+        fprintf (stderr, "Wrong number of waiters in config file (1 to %d)!\n", MAXWAITERS);
+        exit (EXIT_FAILURE);
+    }
+    if ((nChefs < 1) || (nChefs > MAXCHEFS)) {
+        fprintf (stderr, "Wrong number of chefs in config file (1 to %d)!\n", MAXCHEFS);
+        exit (EXIT_FAILURE);
+    }
+    fscanf(fp,"%*[^\n]");                                   /* the rest of the header of the start times */
+
     /* creating and initializing the shared memory region and the log file */
-    if ((shmid = shmemCreate (key, sizeof (SHARED_DATA))) == -1) { 
+    if ((shmid = shmemCreate (key, sharedDataSize (nGroups, nTables, nWaiters, logRing != -1))) == -1) { 
         perror ("error on creating the shared memory region");
         exit (EXIT_FAILURE);
     }
@@ -88,57 +360,87 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         exit (EXIT_FAILURE);
     }
+    setSharedData (sh, nGroups, nTables, nWaiters, nChefs, logRing != -1);
+    if ((pidGR = malloc (nGroups * sizeof (int))) == NULL) {
+        perror ("error on allocating the group process identifiers");
+        exit (EXIT_FAILURE);
+    }
 
     /* initialize random generator */
     srandom ((unsigned int) getpid ());                                
 
     /* initialize problem internal status */
-    sh->fSt.st.chefStat         = WAIT_FOR_ORDER;                     /* the chef waits for an order */
-    sh->fSt.st.waiterStat       = WAIT_FOR_REQUEST;                /* the waiter waits for a request */
+    for (c = 0; c < nChefs; c++) {
+        sh->fSt.st.chefStat[c] = WAIT_FOR_ORDER;                         /* the chefs wait for an order */
+    }
+    for (w = 0; w < nWaiters; w++) {
+        sh->fSt.st.waiterStat[w] = WAIT_FOR_REQUEST;                   /* the waiters wait for a request */
+    }
     sh->fSt.st.receptionistStat = WAIT_FOR_REQUEST;          /* the receptionist waits for a request */
-    for (g = 0; g < MAXGROUPS; g++) {
-        sh->fSt.st.groupStat[g] = GOTOREST;                                /* groups are initialized */
-        sh->fSt.assignedTable[g] = -1;                                     /* groups are initialized */
+    for (g = 0; g < nGroups; g++) {
+        groupStat (&sh->fSt)[g] = GOTOREST;                                /* groups are initialized */
+        assignedTable (&sh->fSt)[g] = -1;                                  /* groups are initialized */
     }
     sh->fSt.groupsWaiting=0;
 
-    FILE *fp = fopen("config.txt","r");
-    if(fp==NULL) {
-        perror("Could not open config file");
-        exit(EXIT_FAILURE);
+    for(g=0;g < nGroups;g++) {
+       fscanf(fp,"%d %d", &startTime (&sh->fSt)[g], &eatTime (&sh->fSt)[g]);
+    }
+    fclose(fp);
+   
+    /* initialize logging control data */
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    sh->logCtl.format       = logFormat;
+    sh->logCtl.stamped      = logStamped;
+    sh->logCtl.perProcess   = logPerProcess;
+    sh->logCtl.seq          = 0;
+    sh->logCtl.written      = 0;
+    sh->logCtl.samplePeriod = samplePeriod;
+    sh->logCtl.sampleDone   = 0;
+    sh->logCtl.t0           = (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+    if (logRing != -1) {
+        createLogRing (&sh->logCtl, logRing);
     }
 
-    /* parse config file */
-    fscanf(fp,"%*[^\n]");
-    fscanf(fp,"%d ",&sh->fSt.nGroups);
-    fscanf(fp,"%*[^\n]");
-    for(g=0;g < sh->fSt.nGroups;g++) {
-       fscanf(fp,"%d %d", &sh->fSt.startTime[g], &sh->fSt.eatTime[g]);
+    /* initialize adaptive down counters */
+    sh->mutexFast    = 0;
+    sh->mutexSpun    = 0;
+    sh->mutexBlocked = 0;
+
+    /* initialize watchdog data */
+    sh->watchdog = watchdog;
+    memset (groupBlockedOn (sh), 0, nGroups * sizeof (BLOCKED_SLOT));
+    for (w = 0; w < nWaiters; w++) {
+        sh->waiterBlockedOn[w].sindex = 0;
     }
-   
+    for (c = 0; c < nChefs; c++) {
+        sh->chefBlockedOn[c].sindex = 0;
+    }
+    sh->receptionistBlockedOn.sindex = 0;
+
+    /* initialize contention statistics */
+    sh->semStatsOn = semStatsOn;
+    memset (semStat (sh), 0, (semNu (sh) + 1) * sizeof (SEMSTAT));
+    if (semStatsOn) {
+        semStats (semStat (sh), semNu (sh) + 1);               /* the watchdog waits with timed downs */
+    }
+
     /* create log file */
+    openLogSession (nFic, &sh->logCtl, "PR");
     createLog (nFic, &sh->fSt);                                  
     saveState(nFic,&sh->fSt);
+    closeLogSession ();
 
     /* initialize semaphore ids */
     sh->mutex                       = MUTEX;                                /* mutual exclusion semaphore id */
     sh->receptionistReq             = RECEPTIONISTREQ;                                                      
     sh->receptionistRequestPossible = RECEPTIONISTREQUESTPOSSIBLE;                                                      
     sh->waiterRequest               = WAITERREQUEST;                                                      
-    sh->waiterRequestPossible       = WAITERREQUESTPOSSIBLE;                                                      
     sh->waitOrder                   = WAITORDER;                                                      
-    sh->orderReceived               = ORDERRECEIVED;                                                      
-    for(g=0;g<sh->fSt.nGroups;g++) {
-       sh->waitForTable[g]          = WAITFORTABLE+g;                                                      
-    }
-    for(t=0;t<NUMTABLES;t++) {
-       sh->foodArrived[t]           = FOODARRIVED+t;                                                      
-       sh->tableDone[t]             = TABLEDONE+t;                                                      
-       sh->requestReceived[t]       = REQUESTRECEIVED+t;                              
-    }
+    sh->rolesDone                   = ROLESDONE;
 
     /* creating and initializing the semaphore set */
-    if ((semgid = semCreate (key, SEM_NU)) == -1) { 
+    if ((semgid = semCreate (key, semNu (sh))) == -1) { 
         perror ("error on creating the semaphore set");
         exit (EXIT_FAILURE);
     }
@@ -146,15 +448,39 @@ int main (int argc, char *argv[])
         perror ("error on executing the up operation for semaphore access");
         exit (EXIT_FAILURE);
     }
-    if (semUp (semgid, sh->waiterRequestPossible) == -1) {                   /* enabling access to critical region */
-        perror ("error on executing the up operation for semaphore access");
-        exit (EXIT_FAILURE);
-    }
     if (semUp (semgid, sh->receptionistRequestPossible) == -1) {                   /* enabling access to critical region */
         perror ("error on executing the up operation for semaphore access");
         exit (EXIT_FAILURE);
     }
 
+    /* logger process */
+    if (logRing != -1) {
+        strcpy (nFicErr + 6, "LG");
+        if ((pidLG = fork ()) < 0) {
+            perror ("error on the fork operation for the logger");
+            exit (EXIT_FAILURE);
+        }
+        if (pidLG == 0)
+            if (execl (LOGGER, LOGGER, nFic, num[1], nFicErr, NULL) < 0) {
+                perror ("error on the generation of the logger process");
+                exit (EXIT_FAILURE);
+            }
+    }
+
+    /* monitor process */
+    if (samplePeriod > 0) {
+        strcpy (nFicErr + 6, "MN");
+        if ((pidMN = fork ()) < 0) {
+            perror ("error on the fork operation for the monitor");
+            exit (EXIT_FAILURE);
+        }
+        if (pidMN == 0)
+            if (execl (MONITOR, MONITOR, nFic, num[1], nFicErr, NULL) < 0) {
+                perror ("error on the generation of the monitor process");
+                exit (EXIT_FAILURE);
+            }
+    }
+
     /* generation of intervening entities processes */                            
     /* group processes */
     strcpy (nFicErr + 6, "GR");
@@ -171,29 +497,38 @@ int main (int argc, char *argv[])
                 exit (EXIT_FAILURE);
             }
     }
-    /* waiter process */
+    /* waiter processes */
     strcpy (nFicErr + 6, "WT");
-    if ((pidWT = fork ()) < 0)  {                            
-        perror ("error on the fork operation for the waiter");
-        exit (EXIT_FAILURE);
-    }
-    if (pidWT == 0) {
-        if (execl (WAITER, WAITER, nFic, num[1], nFicErr, NULL) < 0) {
-            perror ("error on the generation of the waiter process");
+    for (w = 0; w < sh->fSt.nWaiters; w++) {
+        if ((pidWT[w] = fork ()) < 0)  {                            
+            perror ("error on the fork operation for the waiter");
             exit (EXIT_FAILURE);
         }
+        sprintf(num[0],"%d",w);
+        sprintf(nFicErr+8,"%02d",w); 
+        if (pidWT[w] == 0) {
+            if (execl (WAITER, WAITER, num[0], nFic, num[1], nFicErr, NULL) < 0) {
+                perror ("error on the generation of the waiter process");
+                exit (EXIT_FAILURE);
+            }
+        }
     }
-    /* chef process */
+    /* chef processes */
     strcpy (nFicErr + 6, "CH");
-    if ((pidCH = fork ()) < 0) {               
-        perror ("error on the fork operation for the chef");
-        exit (EXIT_FAILURE);
-    }
-    if (pidCH == 0)
-        if (execl (CHEF, CHEF, nFic, num[1], nFicErr, NULL) < 0) { 
-            perror ("error on the generation of the chef process");
+    for (c = 0; c < sh->fSt.nChefs; c++) {
+        if ((pidCH[c] = fork ()) < 0) {
+            perror ("error on the fork operation for the chef");
             exit (EXIT_FAILURE);
         }
+        sprintf(num[0],"%d",c);
+        sprintf(nFicErr+8,"%02d",c); 
+        if (pidCH[c] == 0) {
+            if (execl (CHEF, CHEF, num[0], nFic, num[1], nFicErr, NULL) < 0) {
+                perror ("error on the generation of the chef process");
+                exit (EXIT_FAILURE);
+            }
+        }
+    }
 
     /* receptionist process */
     strcpy (nFicErr + 6, "RT");
@@ -213,7 +548,37 @@ int main (int argc, char *argv[])
         exit (EXIT_FAILURE);
     }
 
-    /* waiting for the termination of the intervening entities processes */
+    /* watchdog: on expiry of the deadline, report the stalled entities, kill every process and clean up */
+    if ((watchdog > 0) && !waitRoles (sh, semgid, watchdog, &pidLG)) {
+        fprintf (stderr, "watchdog: the simulation stalled for %d s\n", watchdog);
+        for (g = 0; g < sh->fSt.nGroups; g++) {
+            sprintf (tag, "GR%02d", g);
+            reportEntity (sh, tag, pidGR[g], groupBlockedOn (sh)[g].sindex);
+            kill (pidGR[g], SIGKILL);
+        }
+        for (w = 0; w < sh->fSt.nWaiters; w++) {
+            sprintf (tag, "WT%02d", w);
+            reportEntity (sh, tag, pidWT[w], sh->waiterBlockedOn[w].sindex);
+            kill (pidWT[w], SIGKILL);
+        }
+        for (c = 0; c < sh->fSt.nChefs; c++) {
+            sprintf (tag, "CH%02d", c);
+            reportEntity (sh, tag, pidCH[c], sh->chefBlockedOn[c].sindex);
+            kill (pidCH[c], SIGKILL);
+        }
+        reportEntity (sh, "RT", pidRT, sh->receptionistBlockedOn.sindex);
+        kill (pidRT, SIGKILL);
+        if (pidMN != -1) kill (pidMN, SIGKILL);
+        if (pidLG != -1) kill (pidLG, SIGKILL);
+        while (wait (NULL) != -1);
+        if ((semDestroy (semgid) == -1) || (shmemDettach (sh) == -1) || (shmemDestroy (shmid) == -1)) {
+            perror ("error on destructing the semaphore set and the shared region");
+        }
+        exit (EXIT_FAILURE);
+    }
+
+    /* waiting for the termination of the intervening entities processes (the logger and the monitor are
+       only reaped here if they terminate early) */
     m = 0;
     do {
         info = wait (&status);
@@ -221,8 +586,45 @@ int main (int argc, char *argv[])
             perror ("error on aiting for an intervening process");
             exit (EXIT_FAILURE);
         }
-        m += 1;
-    } while (m < 3+sh->fSt.nGroups);
+        if (info == pidLG) {
+            loggerLost (sh, status);
+            pidLG = -1;
+        }
+        else if (info == pidMN) {
+            fprintf (stderr, "monitor process terminated early\n");
+            pidMN = -1;
+        }
+        else m += 1;
+    } while (m < 1+sh->fSt.nChefs+sh->fSt.nWaiters+sh->fSt.nGroups);
+
+    /* waiting for the monitor to take its last sample */
+    if (pidMN != -1) {
+        __atomic_store_n (&sh->logCtl.sampleDone, 1, __ATOMIC_RELEASE);
+        if (waitpid (pidMN, &status, 0) == -1) {
+            perror ("error on waiting for the monitor process");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* waiting for the logger to write the remaining records */
+    if (pidLG != -1) {
+        closeLogRing (&sh->logCtl);
+        if (waitpid (pidLG, &status, 0) == -1) {
+            perror ("error on waiting for the logger process");
+            exit (EXIT_FAILURE);
+        }
+    }
+    if ((logRing != -1) && (sh->logCtl.ring.dropped > 0)) {
+        fprintf (stderr, "%u log records dropped (ring full)\n", sh->logCtl.ring.dropped);
+    }
+    logLost = (logRing != -1) && sh->logCtl.ring.abandoned;
+
+    /* report of the contention statistics and of the adaptive downs on the mutex */
+    if (semStatsOn) {
+        reportContention (sh);
+        fprintf (stderr, "mutex: %lu adaptive downs uncontended, %lu completed while spinning, %lu blocked\n",
+                 sh->mutexFast, sh->mutexSpun, sh->mutexBlocked);
+    }
 
     /* destruction of semaphore set and shared region */
     if (semDestroy (semgid) == -1) {
@@ -238,5 +640,5 @@ int main (int argc, char *argv[])
         exit (EXIT_FAILURE);
     }
 
-    return EXIT_SUCCESS;
+    return logLost ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,200 @@
+/**
+ *  \file restaurantlog.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Decoder of log files, and merger of the log segments written by each process.
+ *
+ *  The records of a binary or delta log file are printed on stdout either
+ *    \li in the text layout written by <tt>saveState</tt> (default), or
+ *    \li in the filtered layout of <tt>filter_log.awk</tt>, where role and group states equal to the ones
+ *        of the previous record are replaced by a "." (option <tt>-f</tt>).
+ *
+ *  With option <tt>-t</tt>, each line starts with the record sequence number and its timestamp (ns since
+ *  the start of the simulation).
+ *
+ *  Upon execution, the following optional parameters are accepted:
+ *    \li names of the binary or delta log files (stdin if missing).
+ *
+ *  When several files are given (e.g. the segments <tt>log_*</tt> of a run with per-process logging), they are
+ *  merged as a stream: only the next record of each file is kept, in a heap ordered by sequence number.
+ *  Empty segments (processes that logged nothing) are skipped. The records of a single file, written by all the
+ *  processes, are put back in sequence order as they are read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "logging.h"
+
+/**
+ *  \brief Definition of an input of the merge: an open log file and its next record.
+ */
+typedef struct {
+    /** \brief log file */
+    FILE *fic;
+    /** \brief format of the file */
+    int format;
+    /** \brief next record of the file */
+    LOG_RECORD *rec;
+    /** \brief records read ahead to put the file in sequence order (only for a single file) */
+    LOG_REORDER ro;
+    /** \brief the file is read in sequence order */
+    bool reorder;
+} LOG_INPUT;
+
+/** \brief inputs of the merge (one per file) */
+static LOG_INPUT *in;
+
+/**
+ *  \brief restores the heap property from position i down, in a heap of n inputs ordered by sequence number.
+ */
+static void siftDown (int heap[], int n, int i)
+{
+    int c, tmp;
+
+    while ((c = 2 * i + 1) < n) {
+        if ((c + 1 < n) && (in[heap[c + 1]].rec->seq < in[heap[c]].rec->seq)) {
+            c += 1;
+        }
+        if (in[heap[i]].rec->seq <= in[heap[c]].rec->seq) {
+            break;
+        }
+        tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+        i = c;
+    }
+}
+
+/**
+ *  \brief reads the next record of an input.
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, at end of file
+ */
+static int readInput (LOG_INPUT *p_in, int nGroups)
+{
+    if (p_in->reorder) {
+        return readLogRecordInOrder (p_in->fic, p_in->format, nGroups, &p_in->ro, p_in->rec);
+    }
+    return readLogRecord (p_in->fic, p_in->format, nGroups, p_in->rec);
+}
+
+/**
+ *  \brief opens a log file and reads its header.
+ *
+ *  \return \c 1, upon success
+ *  \return \c 0, if the file is empty
+ */
+static int openInput (LOG_INPUT *p_in, char *name, int *p_nGroups, int *p_nWaiters, int *p_nChefs)
+{
+    if ((name != NULL) && ((p_in->fic = fopen (name, "r")) == NULL)) {
+        perror ("error on opening log file");
+        exit (EXIT_FAILURE);
+    }
+    if (name == NULL) {
+        p_in->fic = stdin;
+    }
+    if ((p_in->format = readLogHeader (p_in->fic, p_nGroups, p_nWaiters, p_nChefs)) == -1) {
+        if (feof (p_in->fic) && (ftell (p_in->fic) <= 0)) {
+            fclose (p_in->fic);
+            return 0;
+        }
+        fprintf (stderr, "%s: not a log file!\n", (name != NULL) ? name : "stdin");
+        exit (EXIT_FAILURE);
+    }
+    p_in->rec = newLogRecord (*p_nGroups, *p_nWaiters, *p_nChefs);
+    return 1;
+}
+
+/**
+ *  \brief Main program.
+ */
+int main (int argc, char *argv[])
+{
+    LOG_RECORD *rec,                                                                               /* current record */
+               *prev = NULL;                                                                      /* previous record */
+    int *heap;                                                                 /* inputs ordered by next record */
+    char *name;                                                                               /* name of a log file */
+    int opt, nGroups = 0, nG, nWaiters = 1, nW, nChefs = 1, nC, nFiles, nIn = 0, i, n = 0;
+    bool filtered = false,
+         stamped = false;
+
+    while ((opt = getopt (argc, argv, "ft")) != -1) {
+        switch (opt) {
+            case 'f':
+                filtered = true;
+                break;
+            case 't':
+                stamped = true;
+                break;
+            default:
+                fprintf (stderr, "USAGE: %s [-f] [-t] [log-file ...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    /* open the inputs and read the first record of each one */
+    nFiles = (argc > optind) ? argc - optind : 1;
+    if (((in = calloc (nFiles, sizeof (LOG_INPUT))) == NULL) || ((heap = malloc (nFiles * sizeof (int))) == NULL)) {
+        perror ("error on allocating the inputs");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < nFiles; i++) {
+        name = (argc > optind) ? argv[optind + i] : NULL;
+        if (!openInput (&in[nIn], name, &nG, &nW, &nC)) {
+            continue;
+        }
+        if ((nIn > 0) && ((nG != nGroups) || (nW != nWaiters) || (nC != nChefs))) {
+            fprintf (stderr, "%s: log files of different runs!\n", name);
+            return EXIT_FAILURE;
+        }
+        nGroups = nG;
+        nWaiters = nW;
+        nChefs = nC;
+        in[nIn].reorder = (nFiles == 1);
+        if (in[nIn].reorder) {
+            initLogReorder (&in[nIn].ro, nGroups, nWaiters, nChefs);
+        }
+        if (readInput (&in[nIn], nGroups) == 0) {
+            heap[nIn] = nIn;
+            nIn++;
+        }
+        else {
+            fclose (in[nIn].fic);
+            free (in[nIn].rec);
+        }
+    }
+    prev = newLogRecord (nGroups, nWaiters, nChefs);
+    for (i = nIn / 2 - 1; i >= 0; i--) {
+        siftDown (heap, nIn, i);
+    }
+
+    if (filtered) {
+        printFilteredTitle (stdout, nGroups, nWaiters, nChefs, stamped);
+    }
+    else printLogTitle (stdout, nGroups, nWaiters, nChefs, stamped);
+
+    /* take the record with the lowest sequence number and replace it by the next one of the same input */
+    while (nIn > 0) {
+        rec = in[heap[0]].rec;
+        if (filtered) {
+            printFilteredRecord (stdout, rec, (n > 0) ? prev : NULL, stamped);
+        }
+        else printLogRecord (stdout, rec, stamped);
+        copyLogRecord (prev, rec);
+        n++;
+
+        if (readInput (&in[heap[0]], nGroups) != 0) {
+            fclose (in[heap[0]].fic);
+            heap[0] = heap[--nIn];
+        }
+        siftDown (heap, nIn, 0);
+    }
+
+    return EXIT_SUCCESS;
+}
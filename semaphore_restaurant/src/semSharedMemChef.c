@@ -6,10 +6,13 @@
  *  Synchronization based on semaphores and shared memory.
  *  Implementation with SVIPC.
  *
- *  Definition of the operations carried out by the chef:
+ *  Definition of the operations carried out by a chef:
  *     \li waitOrder
  *     \li processOrder
  *
+ *  Any number of chefs (config.txt) cook in parallel: each one takes the oldest order of the kitchen queue
+ *  when it is free.
+ *
  *  \author Nuno Lau - December 2023
  */
 
@@ -35,6 +38,9 @@
 /** \brief logging file name */
 static char nFic[51];
 
+/** \brief chef identification */
+static int id;
+
 /** \brief shared memory block access identifier */
 static int shmid;
 
@@ -47,7 +53,10 @@ static int lastGroup;
 /** \brief pointer to shared memory region */
 static SHARED_DATA *sh;
 
-static void waitForOrder ();
+/** \brief snapshot of the state logged by this process */
+static LOG_RECORD *snap;
+
+static bool waitForOrder ();
 static void processOrder ();
 
 /**
@@ -59,20 +68,27 @@ int main (int argc, char *argv[])
 {
     int key;                                          /*access key to shared memory and semaphore set */
     char *tinp;                                                     /* numerical parameters test flag */
+    char tag[8];                                                      /* name of the chef in its log segment */
+    unsigned long fast, spun, blocked;                                             /* adaptive down counters */
 
     /* validation of command line parameters */
 
-    if (argc != 4) { 
+    if (argc != 5) { 
         freopen ("error_CH", "a", stderr);
         fprintf (stderr, "Number of parameters is incorrect!\n");
         return EXIT_FAILURE;
     }
     else {
-       freopen (argv[3], "w", stderr);
+       freopen (argv[4], "w", stderr);
        setbuf(stderr,NULL);
     }
-    strcpy (nFic, argv[1]);
-    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    id = (unsigned int) strtol (argv[1], &tinp, 0);
+    if ((*tinp != '\0') || (id >= MAXCHEFS)) {
+        fprintf (stderr, "Chef process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    strcpy (nFic, argv[2]);
+    key = (unsigned int) strtol (argv[3], &tinp, 0);
     if (*tinp != '\0') {
         fprintf (stderr, "Error on the access key communication!\n");
         return EXIT_FAILURE;
@@ -93,17 +109,45 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    /* trace the semaphore the process is blocked on, for the watchdog of the main process */
+    if (sh->watchdog > 0) {
+        semBlockedOn (&sh->chefBlockedOn[id].sindex);
+    }
+
+    /* record the contention statistics of the semaphores */
+    if (sh->semStatsOn) {
+        semStats (semStat (sh), semNu (sh) + 1);
+    }
+
     /* initialize random generator */
     srandom ((unsigned int) getpid ());                                      
 
-    /* simulation of the life cycle of the chef */
+    /* buffer of the snapshots of the state */
+    snap = newLogRecord (sh->fSt.nGroups, sh->fSt.nWaiters, sh->fSt.nChefs);
+
+    /* open the logging session of this process */
+    sprintf (tag, "CH%02d", id);
+    openLogSession (nFic, &sh->logCtl, tag);
+
+    /* simulation of the life cycle of the chef: the chefs cook one order per group between them */
 
-    int nOrders=0;
-    while(nOrders < sh->fSt.nGroups) {
-        waitForOrder();
+    while(waitForOrder()) {
         processOrder();
+    }
+
+    /* account for the adaptive downs on the mutex */
+    semAdaptiveStats (&fast, &spun, &blocked);
+    __atomic_fetch_add (&sh->mutexFast, fast, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexSpun, spun, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexBlocked, blocked, __ATOMIC_RELAXED);
+
+    /* close the logging session of this process */
+    closeLogSession ();
 
-       nOrders++;
+    /* signal the end of the life cycle to the main process */
+    if (semUp (semgid, sh->rolesDone) == -1) {
+        perror ("error on the up operation for semaphore access (CH)");
+        return EXIT_FAILURE;
     }
 
     /* unmapping the shared region off the process address space */
@@ -119,49 +163,76 @@ int main (int argc, char *argv[])
 /**
  *  \brief chefs wait for a food order.
  *
- *  The chef waits for the food request that will be provided by the waiter.
+ *  The chef waits for a food order placed by a waiter, then takes the oldest one out of the
+ *  kitchen queue (the order the down stands for may be taken by another chef: the queue then
+ *  holds an older one).
+ *  The chef that takes the last order of the simulation wakes up the other ones, which then
+ *  find no order left.
  *  Updates its state and saves internal state.
- *  Received order should be acknowledged.
+ *
+ *  \return true, if an order was taken; false, once all orders are cooked
  */
-static void waitForOrder ()
+static bool waitForOrder ()
 {
-    // Wait for a food order from the waiter
+    request req;
+    unsigned int total = sh->fSt.nGroups;  // orders of the simulation, one per group
+    int k;
+
+    // Stop once all orders are taken
+    if (__atomic_load_n (&sh->chefTaken, __ATOMIC_ACQUIRE) == total) {
+        return false;
+    }
+
+    // Wait for a food order from a waiter
     if (semDown(semgid, sh->waitOrder) == -1) {
         perror("error on the down operation for wait order semaphore (PT)");
         exit(EXIT_FAILURE);
     }
 
-     
-    if (semDown (semgid, sh->mutex) == -1) {                                                      /* enter critical region */
-        perror ("error on the up operation for semaphore access (PT)");
-        exit (EXIT_FAILURE);
+    // Woken up by the chef that took the last order
+    if (__atomic_load_n (&sh->chefTaken, __ATOMIC_ACQUIRE) == total) {
+        return false;
     }
 
-    lastGroup = sh->fSt.foodGroup; // Save the group that requested food
-
-    // Update chef's state to COOK
-    sh->fSt.st.chefStat = COOK;
-    saveState(nFic, &sh->fSt); // Save the state
-    
+    // Take the oldest order (the one the down stands for may not be published yet: look again)
+    while (!takeRequest (sh, &sh->chefQueue, &req)) {
+        sched_yield ();
+    }
+    lastGroup = req.reqGroup; // Save the group that requested food
+
+    // Wake up the other chefs once the last order is taken (the ones not blocked stop without a down)
+    if (__atomic_add_fetch (&sh->chefTaken, 1, __ATOMIC_ACQ_REL) == total) {
+        for (k = 1; k < sh->fSt.nChefs; k++) {
+            if (semUp (semgid, sh->waitOrder) == -1) {
+                perror("error on the up operation for wait order semaphore (PT)");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
 
-    // Acknowledge the received order
-    if (semUp(semgid, sh->orderReceived) == -1) {
-        perror("error on the up operation for order received semaphore (PT)");
-        exit(EXIT_FAILURE);
+    if (semDownAdaptive (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+        perror ("error on the down operation for semaphore access (PT)");
+        exit (EXIT_FAILURE);
     }
 
+    // Update chef's state to COOK
+    sh->fSt.st.chefStat[id] = COOK;
+    snapshotState (snap, &sh->fSt); // Save the state
+
     if (semUp (semgid, sh->mutex) == -1) {                                                      /* exit critical region */
         perror ("error on the up operation for semaphore access (PT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
+    return true;
 }
 
 /**
  *  \brief chef cooks, then delivers the food to the waiter 
  *
  *  The chef takes some time to cook and signals the waiter that food is 
- *  ready (this may only happen when waiter is available)
+ *  ready (the request is queued, the waiter may be busy)
  *  then updates its state.
  *  The internal state should be saved.
  */
@@ -170,34 +241,25 @@ static void processOrder ()
     // Simulate cooking time
     usleep((unsigned int) floor ((MAXCOOK * random ()) / RAND_MAX + 100.0));
 
-    // Wait for waiter to be available
-    if (semDown (semgid, sh->waiterRequestPossible) == -1) {
-        perror ("error on the up operation for chef semaphore access (PT)");
-        exit (EXIT_FAILURE);
-    }
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                      /* enter critical region */
-        perror ("error on the up operation for semaphore access (PT)");
+    if (semDownAdaptive (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+        perror ("error on the down operation for semaphore access (PT)");
         exit (EXIT_FAILURE);
     }
 
-    // request waiter to deliver food
-    sh->fSt.waiterRequest.reqGroup = lastGroup;
-    sh->fSt.waiterRequest.reqType = FOODREADY;
+    // request the waiters of the zone of the table to deliver food
+    postRequest (sh, waiterZone (sh, assignedTable (&sh->fSt)[lastGroup]), FOODREADY, lastGroup);
 
 
-    if (semUp (semgid, sh->waiterRequest) == -1) {
-        perror ("error on the up operation for chef semaphore access (PT)");
-        exit (EXIT_FAILURE);
-    }
-
     // Update chef's state to WAIT_FOR_ORDER
-    sh->fSt.st.chefStat = WAIT_FOR_ORDER;
-    saveState(nFic, &sh->fSt); // Save the state
+    sh->fSt.st.chefStat[id] = WAIT_FOR_ORDER;
+    snapshotState (snap, &sh->fSt); // Save the state
 
-    if (semUp (semgid, sh->mutex) == -1) {                                                      /* exit critical region */
-        perror ("error on the up operation for semaphore access (PT)");
+    // Signal the waiter and exit critical region
+    SEMOP leave[2] = {{ sh->waiterRequest, 1 }, { sh->mutex, 1 }};
+    if (semOps (semgid, leave, 2) == -1) {
+        perror ("error on the up operation for chef semaphore access (PT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 }
 
@@ -44,6 +44,9 @@ static int semgid;
 /** \brief pointer to shared memory region */
 static SHARED_DATA *sh;
 
+/** \brief snapshot of the state logged by this process */
+static LOG_RECORD *snap;
+
 static void goToRestaurant (int id);
 static void checkInAtReception (int id);
 static void orderFood (int id);
@@ -61,6 +64,8 @@ int main (int argc, char *argv[])
 {
     int key;                                         /*access key to shared memory and semaphore set */
     char *tinp;                                                    /* numerical parameters test flag */
+    unsigned long fast, spun, blocked;                                     /* adaptive down counters */
+    char tag[16];                                                               /* name of the group */
     int n;
 
     /* validation of command line parameters */
@@ -75,7 +80,7 @@ int main (int argc, char *argv[])
     }
 
     n = (unsigned int) strtol (argv[1], &tinp, 0);
-    if ((*tinp != '\0') || (n >= MAXGROUPS )) { 
+    if ((*tinp != '\0') || (n < 0)) { 
         fprintf (stderr, "Group process identification is wrong!\n");
         return EXIT_FAILURE;
     }
@@ -100,10 +105,31 @@ int main (int argc, char *argv[])
         perror ("error on mapping the shared region on the process address space");
         return EXIT_FAILURE;
     }
+    if (n >= sh->fSt.nGroups) { 
+        fprintf (stderr, "Group process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+
+    /* trace the semaphore the process is blocked on, for the watchdog of the main process */
+    if (sh->watchdog > 0) {
+        semBlockedOn (&groupBlockedOn (sh)[n].sindex);
+    }
+
+    /* record the contention statistics of the semaphores */
+    if (sh->semStatsOn) {
+        semStats (semStat (sh), semNu (sh) + 1);
+    }
 
     /* initialize random generator */
     srandom ((unsigned int) getpid ());                                                 
 
+    /* buffer of the snapshots of the state */
+    snap = newLogRecord (sh->fSt.nGroups, sh->fSt.nWaiters, sh->fSt.nChefs);
+
+    /* open the logging session of this process */
+    sprintf (tag, "GR%02d", n);
+    openLogSession (nFic, &sh->logCtl, tag);
+
 
     /* simulation of the life cycle of the group */
     goToRestaurant(n);
@@ -113,6 +139,21 @@ int main (int argc, char *argv[])
     eat(n);
     checkOutAtReception(n);
     
+    /* account for the adaptive downs on the mutex */
+    semAdaptiveStats (&fast, &spun, &blocked);
+    __atomic_fetch_add (&sh->mutexFast, fast, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexSpun, spun, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexBlocked, blocked, __ATOMIC_RELAXED);
+
+    /* close the logging session of this process */
+    closeLogSession ();
+
+    /* signal the end of the life cycle to the main process */
+    if (semUp (semgid, sh->rolesDone) == -1) {
+        perror ("error on the up operation for semaphore access (CT)");
+        return EXIT_FAILURE;
+    }
+
     /* unmapping the shared region off the process address space */
     if (shmemDettach (sh) == -1) {
         perror ("error on unmapping the shared region off the process address space");
@@ -151,10 +192,10 @@ static double normalRand(double stddev)
  */
 static void goToRestaurant (int id)
 {
-    double startTime = sh->fSt.startTime[id] + normalRand(STARTDEV);
+    double t = startTime (&sh->fSt)[id] + normalRand(STARTDEV);
 
-    if (startTime > 0.0) {
-        usleep((unsigned int) startTime );
+    if (t > 0.0) {
+        usleep((unsigned int) t );
     }
 }
 
@@ -167,10 +208,10 @@ static void goToRestaurant (int id)
  */
 static void eat (int id)
 {
-    double eatTime = sh->fSt.eatTime[id] + normalRand(EATDEV);
+    double t = eatTime (&sh->fSt)[id] + normalRand(EATDEV);
 
-    if (eatTime > 0.0) {
-        usleep((unsigned int) eatTime );
+    if (t > 0.0) {
+        usleep((unsigned int) t );
     }
 }
 
@@ -188,40 +229,31 @@ static void eat (int id)
  */
 static void checkInAtReception(int id)
 {
-    // Wait until the receptionist is ready to take a request
-    if (semDown (semgid, sh->receptionistRequestPossible) == -1) {
-        perror ("error on the down operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    // Wait until the receptionist is ready to take a request, then enter critical region
+    SEMOP enter[2] = {{ sh->receptionistRequestPossible, -1 }, { sh->mutex, -1 }};
+    if (semOps (semgid, enter, 2) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to ATRECEPTION and save state
-    sh->fSt.st.groupStat[id] = ATRECEPTION; 
-    saveState(nFic, &sh->fSt);
+    groupStat (&sh->fSt)[id] = ATRECEPTION; 
+    snapshotState (snap, &sh->fSt);
 
     // Prepare and send table request to receptionist
     sh->fSt.receptionistRequest.reqType = TABLEREQ;
     sh->fSt.receptionistRequest.reqGroup = id;
 
-    // Signal receptionist that a new request has been made
-    if (semUp (semgid, sh->receptionistReq) == -1) {
-        perror ("error on the up operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    if (semUp (semgid, sh->mutex) == -1) {                                                      /* exit critical region */
+    // Signal receptionist that a new request has been made and exit critical region
+    SEMOP leave[2] = {{ sh->receptionistReq, 1 }, { sh->mutex, 1 }};
+    if (semOps (semgid, leave, 2) == -1) {
         perror ("error on the up operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
     // Wait for a table to be assigned
-    if (semDown (semgid, sh->waitForTable[id]) == -1) {
+    if (semDown (semgid, waitForTable (sh, id)) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
@@ -239,43 +271,31 @@ static void checkInAtReception(int id)
  */
 static void orderFood (int id)
 {
-    // Wait until it's possible to make a request to the waiter
-    if (semDown (semgid, sh->waiterRequestPossible) == -1) {
-        perror ("error on the down operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    if (semDownAdaptive (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to FOOD_REQUEST and save state
-    sh->fSt.st.groupStat[id] = FOOD_REQUEST;
-    saveState(nFic, &sh->fSt);
-
-    // Prepare food request for the waiter
-    sh->fSt.waiterRequest.reqType = FOODREQ;
-    sh->fSt.waiterRequest.reqGroup = id;
-
-    // Signal waiter that a new food request has been made
-    if (semUp (semgid, sh->waiterRequest) == -1) {
-        perror ("error on the up operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
+    groupStat (&sh->fSt)[id] = FOOD_REQUEST;
+    snapshotState (snap, &sh->fSt);
 
     // Get assigned table of the group
-    int tableId = sh->fSt.assignedTable[id];
+    int tableId = assignedTable (&sh->fSt)[id];
 
+    // Post food request to the waiters of the zone of the table
+    postRequest (sh, waiterZone (sh, tableId), FOODREQ, id);
 
-    if (semUp (semgid, sh->mutex) == -1) {                                                     /* exit critical region */
+    // Signal waiter that a new food request has been made and exit critical region
+    SEMOP leave[2] = {{ sh->waiterRequest, 1 }, { sh->mutex, 1 }};
+    if (semOps (semgid, leave, 2) == -1) {
         perror ("error on the up operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
     // Wait for the waiter to acknowledge the food request
-    if (semDown (semgid, sh->requestReceived[tableId]) == -1) {
+    if (semDown (semgid, requestReceived (sh, tableId)) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
@@ -292,45 +312,42 @@ static void orderFood (int id)
  */
 static void waitFood (int id)
 {
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    if (semDownAdaptive (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to WAIT_FOR_FOOD and save state
-    sh->fSt.st.groupStat[id] = WAIT_FOR_FOOD;
-    saveState(nFic, &sh->fSt);
+    groupStat (&sh->fSt)[id] = WAIT_FOR_FOOD;
+    snapshotState (snap, &sh->fSt);
 
     // Get assigned table of the group
-    int tableId = sh->fSt.assignedTable[id];
+    int tableId = assignedTable (&sh->fSt)[id];
 
 
     if (semUp (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
-    // Wait for the food to arrive
-    if (semDown (semgid, sh->foodArrived[tableId]) == -1) {
-        perror ("error on the down operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    // Wait for the food to arrive, then enter critical region
+    SEMOP enter[2] = {{ foodArrived (sh, tableId), -1 }, { sh->mutex, -1 }};
+    if (semOps (semgid, enter, 2) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to EAT and save state
-    sh->fSt.st.groupStat[id] = EAT;
-    saveState(nFic, &sh->fSt);
+    groupStat (&sh->fSt)[id] = EAT;
+    snapshotState (snap, &sh->fSt);
 
 
     if (semUp (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 }
 
 /**
@@ -346,60 +363,48 @@ static void waitFood (int id)
  */
 static void checkOutAtReception (int id)
 {
-    // Wait until the receptionist is ready to process the checkout
-    if (semDown (semgid, sh->receptionistRequestPossible) == -1) {
-        perror ("error on the down operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    // Wait until the receptionist is ready to process the checkout, then enter critical region
+    SEMOP enter[2] = {{ sh->receptionistRequestPossible, -1 }, { sh->mutex, -1 }};
+    if (semOps (semgid, enter, 2) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to CHECKOUT and save state
-    sh->fSt.st.groupStat[id] = CHECKOUT;
-    saveState(nFic, &sh->fSt);
+    groupStat (&sh->fSt)[id] = CHECKOUT;
+    snapshotState (snap, &sh->fSt);
 
     // Prepare payment request for the receptionist
     sh->fSt.receptionistRequest.reqType = BILLREQ;
     sh->fSt.receptionistRequest.reqGroup = id;
 
-    // Signal receptionist that a new payment request has been made
-    if (semUp (semgid, sh->receptionistReq) == -1) {
-        perror ("error on the up operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
-
     // Get assigned table of the group
-    int tableId = sh->fSt.assignedTable[id];
-
-    if (semUp (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
-        perror ("error on the down operation for semaphore access (CT)");
-        exit (EXIT_FAILURE);
-    }
+    int tableId = assignedTable (&sh->fSt)[id];
 
-    // Wait for the receptionist to acknowledge the payment
-    if (semDown (semgid, sh->tableDone[tableId]) == -1) {
-        perror ("error on the down operation for semaphore access (CT)");
+    // Signal receptionist that a new payment request has been made and exit critical region
+    SEMOP leave[2] = {{ sh->receptionistReq, 1 }, { sh->mutex, 1 }};
+    if (semOps (semgid, leave, 2) == -1) {
+        perror ("error on the up operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
-
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    // Wait for the receptionist to acknowledge the payment, then enter critical region
+    SEMOP ack[2] = {{ tableDone (sh, tableId), -1 }, { sh->mutex, -1 }};
+    if (semOps (semgid, ack, 2) == -1) {
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
 
     // Update group status to LEAVING and save state
-    sh->fSt.st.groupStat[id] = LEAVING;
-    saveState(nFic, &sh->fSt);
+    groupStat (&sh->fSt)[id] = LEAVING;
+    snapshotState (snap, &sh->fSt);
 
 
     if (semUp (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (CT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
 }
\ No newline at end of file
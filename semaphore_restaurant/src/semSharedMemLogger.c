@@ -0,0 +1,86 @@
+/**
+ *  \file semSharedMemLogger.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Synchronization based on semaphores and shared memory.
+ *  Implementation with SVIPC.
+ *
+ *  Life cycle of the logger: the process takes the records that the intervening entities place in the
+ *  log ring buffer and writes them to the logging file, so that no file I/O happens inside the critical region.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <string.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#include "logging.h"
+#include "sharedDataSync.h"
+#include "semaphore.h"
+#include "sharedMemory.h"
+
+/** \brief logging file name */
+static char nFic[51];
+
+/** \brief shared memory block access identifier */
+static int shmid;
+
+/** \brief pointer to shared memory region */
+static SHARED_DATA *sh;
+
+/**
+ *  \brief Main program.
+ *
+ *  Its role is to write to the logging file the records produced by the intervening entities.
+ */
+int main (int argc, char *argv[])
+{
+    int key;                                            /*access key to shared memory and semaphore set */
+    char *tinp;                                                       /* numerical parameters test flag */
+    unsigned long nRec;                                                      /* number of records written */
+
+    /* validation of command line parameters */
+    if (argc != 4) {
+        freopen ("error_LG", "a", stderr);
+        fprintf (stderr, "Number of parameters is incorrect!\n");
+        return EXIT_FAILURE;
+    }
+    else {
+        freopen (argv[3], "w", stderr);
+        setbuf(stderr,NULL);
+    }
+
+    strcpy (nFic, argv[1]);
+    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    if (*tinp != '\0') {
+        fprintf (stderr, "Error on the access key communication!\n");
+        return EXIT_FAILURE;
+    }
+
+    /* connection to the shared memory region and mapping the shared region onto the process address space */
+    if ((shmid = shmemConnect (key)) == -1) {
+        perror ("error on connecting to the shared memory region");
+        return EXIT_FAILURE;
+    }
+    if (shmemAttach (shmid, (void **) &sh) == -1) {
+        perror ("error on mapping the shared region on the process address space");
+        return EXIT_FAILURE;
+    }
+
+    /* drain the log ring buffer until the launcher closes it */
+    nRec = drainLogRing (nFic, &sh->logCtl);
+    fprintf (stderr, "%lu records written, %u dropped\n", nRec, sh->logCtl.ring.dropped);
+
+    /* unmapping the shared region off the process address space */
+    if (shmemDettach (sh) == -1) {
+        perror ("error on unmapping the shared region off the process address space");
+        return EXIT_FAILURE;;
+    }
+
+    return EXIT_SUCCESS;
+}
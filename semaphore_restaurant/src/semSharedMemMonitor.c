@@ -0,0 +1,131 @@
+/**
+ *  \file semSharedMemMonitor.c (implementation file)
+ *
+ *  \brief Problem name: Restaurant
+ *
+ *  Synchronization based on semaphores and shared memory.
+ *  Implementation with SVIPC.
+ *
+ *  Life cycle of the monitor: the process samples the full state of the problem at a fixed period and
+ *  writes each sample to the logging file, so that the state trajectory is kept without logging every
+ *  transition (see <tt>LOG_SAMPLING</tt> in logging.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <string.h>
+
+#include "probConst.h"
+#include "probDataStruct.h"
+#define  LOG_SAMPLER
+#include "logging.h"
+#include "sharedDataSync.h"
+#include "semaphore.h"
+#include "sharedMemory.h"
+
+/** \brief logging file name */
+static char nFic[51];
+
+/** \brief shared memory block access identifier */
+static int shmid;
+
+/** \brief semaphore set access identifier */
+static int semgid;
+
+/** \brief pointer to shared memory region */
+static SHARED_DATA *sh;
+
+/** \brief snapshot of the state logged by this process */
+static LOG_RECORD *snap;
+
+/**
+ *  \brief takes a sample of the full state inside the critical region and writes it after leaving it.
+ */
+static void sampleState (void)
+{
+    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+        perror ("error on the down operation for semaphore access (MN)");
+        exit (EXIT_FAILURE);
+    }
+
+    snapshotState (snap, &sh->fSt);
+
+    if (semUp (semgid, sh->mutex) == -1) {                                                     /* exit critical region */
+        perror ("error on the up operation for semaphore access (MN)");
+        exit (EXIT_FAILURE);
+    }
+
+    writeSnapshot (nFic, snap);
+}
+
+/**
+ *  \brief Main program.
+ *
+ *  Its role is to sample the full state of the problem until the launcher signals the end of the simulation;
+ *  a last sample is taken then.
+ */
+int main (int argc, char *argv[])
+{
+    int key;                                            /*access key to shared memory and semaphore set */
+    char *tinp;                                                       /* numerical parameters test flag */
+    unsigned long nSamples = 0;                                                        /* number of samples */
+    bool done;
+
+    /* validation of command line parameters */
+    if (argc != 4) {
+        freopen ("error_MN", "a", stderr);
+        fprintf (stderr, "Number of parameters is incorrect!\n");
+        return EXIT_FAILURE;
+    }
+    else {
+        freopen (argv[3], "w", stderr);
+        setbuf(stderr,NULL);
+    }
+
+    strcpy (nFic, argv[1]);
+    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    if (*tinp != '\0') {
+        fprintf (stderr, "Error on the access key communication!\n");
+        return EXIT_FAILURE;
+    }
+
+    /* connection to the semaphore set and the shared memory region and mapping the shared region onto the
+       process address space */
+    if ((semgid = semConnect (key)) == -1) {
+        perror ("error on connecting to the semaphore set");
+        return EXIT_FAILURE;
+    }
+    if ((shmid = shmemConnect (key)) == -1) {
+        perror ("error on connecting to the shared memory region");
+        return EXIT_FAILURE;
+    }
+    if (shmemAttach (shmid, (void **) &sh) == -1) {
+        perror ("error on mapping the shared region on the process address space");
+        return EXIT_FAILURE;
+    }
+
+    /* sample the state until the end of the simulation */
+    snap = newLogRecord (sh->fSt.nGroups, sh->fSt.nWaiters, sh->fSt.nChefs);
+    openLogSession (nFic, &sh->logCtl, "MN");
+    do {
+        done = __atomic_load_n (&sh->logCtl.sampleDone, __ATOMIC_ACQUIRE);
+        sampleState ();
+        nSamples += 1;
+        if (!done) {
+            usleep (sh->logCtl.samplePeriod);
+        }
+    } while (!done);
+    closeLogSession ();
+    fprintf (stderr, "%lu samples taken\n", nSamples);
+
+    /* unmapping the shared region off the process address space */
+    if (shmemDettach (sh) == -1) {
+        perror ("error on unmapping the shared region off the process address space");
+        return EXIT_FAILURE;;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -46,6 +46,9 @@ static int semgid;
 /** \brief pointer to shared memory region */
 static SHARED_DATA *sh;
 
+/** \brief snapshot of the state logged by this process */
+static LOG_RECORD *snap;
+
 /* constants for groupRecord */
 #define TOARRIVE 0
 #define WAIT     1
@@ -53,7 +56,45 @@ static SHARED_DATA *sh;
 #define DONE     3
 
 /** \brief receptioninst view on each group evolution (useful to decide table binding) */
-static int groupRecord[MAXGROUPS];
+static int *groupRecord;
+
+/** \brief number of bits of a word of a bitmap */
+#define WORDBITS 64
+
+/** \brief receptionist view on the groups: bit g is set while group g waits for a table */
+static unsigned long long *waitingGroups;
+
+/** \brief receptionist view on the tables: bit t is set while table t is free (the receptionist alone assigns them) */
+static unsigned long long *freeTables;
+
+/** \brief allocates a bitmap of n bits, all clear */
+static unsigned long long *newBitmap (int n)
+{
+    return calloc ((n + WORDBITS - 1) / WORDBITS, sizeof (unsigned long long));
+}
+
+/** \brief sets bit i of a bitmap */
+static void setBit (unsigned long long *map, int i)
+{
+    map[i / WORDBITS] |= 1ULL << (i % WORDBITS);
+}
+
+/** \brief clears bit i of a bitmap */
+static void clearBit (unsigned long long *map, int i)
+{
+    map[i / WORDBITS] &= ~(1ULL << (i % WORDBITS));
+}
+
+/** \brief lowest bit set in a bitmap of n bits (-1 if none): one count-trailing-zeros per non-empty word */
+static int firstBit (unsigned long long *map, int n)
+{
+    for (int w = 0; w < (n + WORDBITS - 1) / WORDBITS; w++) {
+        if (map[w] != 0) {
+            return w * WORDBITS + __builtin_ctzll (map[w]);
+        }
+    }
+    return -1;
+}
 
 
 /** \brief receptionist waits for next request */
@@ -76,6 +117,7 @@ int main (int argc, char *argv[])
 {
     int key;                                            /*access key to shared memory and semaphore set */
     char *tinp;                                                       /* numerical parameters test flag */
+    unsigned long fast, spun, blocked;                                        /* adaptive down counters */
 
     /* validation of command line parameters */
     if (argc != 4) { 
@@ -110,14 +152,39 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    /* trace the semaphore the process is blocked on, for the watchdog of the main process */
+    if (sh->watchdog > 0) {
+        semBlockedOn (&sh->receptionistBlockedOn.sindex);
+    }
+
+    /* record the contention statistics of the semaphores */
+    if (sh->semStatsOn) {
+        semStats (semStat (sh), semNu (sh) + 1);
+    }
+
     /* initialize random generator */
     srandom ((unsigned int) getpid ());              
 
+    /* buffer of the snapshots of the state */
+    snap = newLogRecord (sh->fSt.nGroups, sh->fSt.nWaiters, sh->fSt.nChefs);
+
+    /* open the logging session of this process */
+    openLogSession (nFic, &sh->logCtl, "RT");
+
     /* initialize internal receptionist memory */
+    if (((groupRecord = malloc (sh->fSt.nGroups * sizeof (int))) == NULL) ||
+        ((waitingGroups = newBitmap (sh->fSt.nGroups)) == NULL) ||
+        ((freeTables = newBitmap (sh->fSt.nTables)) == NULL)) {
+        perror ("error on allocating the receptionist memory");
+        return EXIT_FAILURE;
+    }
     int g;
     for (g=0; g < sh->fSt.nGroups; g++) {
        groupRecord[g] = TOARRIVE;
     }
+    for (g=0; g < sh->fSt.nTables; g++) {
+       setBit (freeTables, g);
+    }
 
     /* simulation of the life cycle of the receptionist */
     int nReq=0;
@@ -135,6 +202,21 @@ int main (int argc, char *argv[])
         nReq++;
     }
 
+    /* account for the adaptive downs on the mutex */
+    semAdaptiveStats (&fast, &spun, &blocked);
+    __atomic_fetch_add (&sh->mutexFast, fast, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexSpun, spun, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexBlocked, blocked, __ATOMIC_RELAXED);
+
+    /* close the logging session of this process */
+    closeLogSession ();
+
+    /* signal the end of the life cycle to the main process */
+    if (semUp (semgid, sh->rolesDone) == -1) {
+        perror ("error on the up operation for semaphore access (RT)");
+        return EXIT_FAILURE;
+    }
+
     /* unmapping the shared region off the process address space */
     if (shmemDettach (sh) == -1) {
         perror ("error on unmapping the shared region off the process address space");
@@ -154,29 +236,12 @@ int main (int argc, char *argv[])
 static int decideTableOrWait(int n)
 {
     // Ensure the group is at the reception
-    if (sh->fSt.st.groupStat[n] != ATRECEPTION) {
+    if (groupStat (&sh->fSt)[n] != ATRECEPTION) {
         return -1;
     }
 
-    // Iterate through each table to check if it is occupied
-    for (int tableId = 0; tableId < NUMTABLES; tableId++) {
-        bool isOccupied = false;
-        
-        // Check if the current tableId is assigned to any group
-        for (int groupId = 0; groupId < sh->fSt.nGroups; groupId++) {
-            if (sh->fSt.assignedTable[groupId] == tableId) {
-                isOccupied = true;
-                break; // This table is already occupied
-            }
-        }
-
-        // If the table is not occupied, return its ID
-        if (!isOccupied) {
-            return tableId;
-        }
-    }
-
-    return -1; // All tables are occupied, so the group must wait
+    // Lowest free table, or -1 if all tables are occupied (the group must wait)
+    return firstBit (freeTables, sh->fSt.nTables);
 }
 
 /**
@@ -189,13 +254,14 @@ static int decideTableOrWait(int n)
  */
 static int decideNextGroup()
 { 
-    for (int groupId = 0; groupId < sh->fSt.nGroups; groupId++) {
-        if (decideTableOrWait(groupId) != -1 && groupRecord[groupId] == WAIT) {
-            return groupId;
-        }
+    // Lowest waiting group, or -1 if no group is waiting
+    int groupId = firstBit (waitingGroups, sh->fSt.nGroups);
+
+    if (groupId != -1 && decideTableOrWait(groupId) != -1) {
+        return groupId;
     }
 
-    return -1; // Return the group ID or -1 if no group is waiting
+    return -1;
 }
 
 /**
@@ -210,47 +276,39 @@ static int decideNextGroup()
 static request waitForGroup()
 {
     request ret; 
-    if (semDown (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
+    if (semDownAdaptive (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // Update receptionist status to WAIT_FOR_REQUEST and save the state
     sh->fSt.st.receptionistStat = WAIT_FOR_REQUEST;
-    saveState(nFic, &sh->fSt);
+    snapshotState (snap, &sh->fSt);
 
     if (semUp (semgid, sh->mutex) == -1)      {                                             /* exit critical region */
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
-    // Wait for a group to make a request
-    if (semDown(semgid, sh->receptionistReq) == -1) {
+    // Wait for a group to make a request, then enter critical region
+    SEMOP enter[2] = {{ sh->receptionistReq, -1 }, { sh->mutex, -1 }};
+    if (semOps(semgid, enter, 2) == -1) {
         perror("error on the down operation for receptionist semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
-    
-    if (semDown (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
-        perror ("error on the up operation for semaphore access (WT)");
-        exit (EXIT_FAILURE);
-    }
 
     // Copy the request details from shared memory
     ret.reqGroup = sh->fSt.receptionistRequest.reqGroup;
     ret.reqType = sh->fSt.receptionistRequest.reqType;
 
 
-    // Signal that the receptionist is ready for new requests
-    if (semUp (semgid, sh->receptionistRequestPossible) == -1) {
+    // Signal that the receptionist is ready for new requests and exit critical region
+    SEMOP leave[2] = {{ sh->receptionistRequestPossible, 1 }, { sh->mutex, 1 }};
+    if (semOps (semgid, leave, 2) == -1) {
         perror ("error on the up operation for receptionist semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
-
-
-    if (semUp (semgid, sh->mutex) == -1) {                                             /* exit critical region */
-        perror ("error on the up operation for semaphore access (WT)");
-        exit (EXIT_FAILURE);
-    }
     
     return ret;
 }
@@ -266,7 +324,11 @@ static request waitForGroup()
  */
 static void provideTableOrWaitingRoom (int n)
 {
-    if (semDown (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
+    bool logged = false;                                                         /* state changed and was logged */
+    SEMOP leave[2];                                                  /* ups done when exiting the critical region */
+    unsigned int nOps = 0;
+
+    if (semDownAdaptive (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
@@ -282,22 +344,22 @@ static void provideTableOrWaitingRoom (int n)
 
             // Update receptionist status to ASSIGNTABLE and save the state
             sh->fSt.st.receptionistStat = ASSIGNTABLE;
-            saveState(nFic, &sh->fSt);
+            snapshotState (snap, &sh->fSt);
+            logged = true;
 
             // Assign the table to the group
-            sh->fSt.assignedTable[n] = tableId;
+            assignedTable (&sh->fSt)[n] = tableId;
+            clearBit (freeTables, tableId);
             
-            // Signal the group that it can proceed to the table
-            if (semUp(semgid, sh->waitForTable[n]) == -1) {
-                perror("error on the up operation for group wait for table semaphore (RT)");
-                exit(EXIT_FAILURE);
-            }
+            // Signal the group that it can proceed to the table (when exiting the critical region)
+            leave[nOps++] = (SEMOP) { waitForTable (sh, n), 1 };
 
             groupRecord[n] = ATTABLE;  // Update internal receptionist view
 
         } else {
             // If the group must wait
             groupRecord[n] = WAIT;  // Update internal receptionist view
+            setBit (waitingGroups, n);
 
             sh->fSt.groupsWaiting++;  // Update the number of groups waiting
         }
@@ -305,10 +367,14 @@ static void provideTableOrWaitingRoom (int n)
     }
     
 
-    if (semUp (semgid, sh->mutex) == -1) {                                               /* exit critical region */
+    leave[nOps++] = (SEMOP) { sh->mutex, 1 };
+    if (semOps (semgid, leave, nOps) == -1) {                                           /* exit critical region */
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
+    if (logged) {
+        writeSnapshot (nFic, snap);
+    }
 
 }
 
@@ -323,26 +389,28 @@ static void provideTableOrWaitingRoom (int n)
  */
 static void receivePayment (int n)
 {
-    if (semDown (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
+    SEMOP leave[3];                                                  /* ups done when exiting the critical region */
+    unsigned int nOps = 0;
+
+    if (semDownAdaptive (semgid, sh->mutex) == -1)  {                                                  /* enter critical region */
         perror ("error on the up operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // Update receptionist state to receiving payment and save the state
     sh->fSt.st.receptionistStat = RECVPAY;
-    saveState(nFic, &sh->fSt);
+    snapshotState (snap, &sh->fSt);
     
     
     // Identify the table being vacated
-    int tableId = sh->fSt.assignedTable[n];
+    int tableId = assignedTable (&sh->fSt)[n];
 
-    if (semUp (semgid, sh->tableDone[tableId]) == -1)  {
-     perror ("error on the down operation for receptionist semaphore access (WT)");
-        exit (EXIT_FAILURE);
-    }
+    // Acknowledge the payment (when exiting the critical region)
+    leave[nOps++] = (SEMOP) { tableDone (sh, tableId), 1 };
 
     groupRecord[n] = DONE;  // Update the internal receptionist view to indicate the group is done
-    sh->fSt.assignedTable[n] = -1; // Mark the table as vacant
+    assignedTable (&sh->fSt)[n] = -1; // Mark the table as vacant
+    setBit (freeTables, tableId);
     
 
     // Check if there are waiting groups
@@ -355,15 +423,14 @@ static void receivePayment (int n)
             // If there is a group waiting
 
             // Assign the table to the group
-            sh->fSt.assignedTable[nextGroup] = tableId;
+            assignedTable (&sh->fSt)[nextGroup] = tableId;
+            clearBit (freeTables, tableId);
             groupRecord[nextGroup] = ATTABLE;
+            clearBit (waitingGroups, nextGroup);
 
 
-            // Signal the group that it can proceed to the table
-            if (semUp(semgid, sh->waitForTable[nextGroup]) == -1) {
-                perror("error on the up operation for group wait for table semaphore (RT)");
-                exit(EXIT_FAILURE);
-            }
+            // Signal the group that it can proceed to the table (when exiting the critical region)
+            leave[nOps++] = (SEMOP) { waitForTable (sh, nextGroup), 1 };
             
             // Decrease the number of groups waiting
             sh->fSt.groupsWaiting--;
@@ -371,10 +438,12 @@ static void receivePayment (int n)
     }
   
 
-    if (semUp (semgid, sh->mutex) == -1)  {                                                  /* exit critical region */
+    leave[nOps++] = (SEMOP) { sh->mutex, 1 };
+    if (semOps (semgid, leave, nOps) == -1)  {                                               /* exit critical region */
      perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
+    writeSnapshot (nFic, snap);
 
 }
 
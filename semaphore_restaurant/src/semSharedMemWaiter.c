@@ -6,11 +6,14 @@
  *  Synchronization based on semaphores and shared memory.
  *  Implementation with SVIPC.
  *
- *  Definition of the operations carried out by the waiter:
+ *  Definition of the operations carried out by a waiter:
  *     \li waitForClientOrChef
  *     \li informChef
  *     \li takeFoodToTable
  *
+ *  Any number of waiters (config.txt) share the work: each one takes the requests of the tables of its own zone
+ *  first, and the ones of the other zones when its own has none.
+ *
  *  \author Nuno Lau - December 2023
  */
 
@@ -33,6 +36,9 @@
 /** \brief logging file name */
 static char nFic[51];
 
+/** \brief waiter identification */
+static int id;
+
 /** \brief shared memory block access identifier */
 static int shmid;
 
@@ -42,6 +48,9 @@ static int semgid;
 /** \brief pointer to shared memory region */
 static SHARED_DATA *sh;
 
+/** \brief snapshot of the state logged by this process */
+static LOG_RECORD *snap;
+
 /** \brief waiter waits for next request */
 static request waitForClientOrChef ();
 
@@ -63,20 +72,27 @@ int main (int argc, char *argv[])
 {
     int key;                                            /*access key to shared memory and semaphore set */
     char *tinp;                                                       /* numerical parameters test flag */
+    char tag[8];                                                      /* name of the waiter in its log segment */
+    unsigned long fast, spun, blocked;                                        /* adaptive down counters */
 
     /* validation of command line parameters */
-    if (argc != 4) { 
+    if (argc != 5) { 
         freopen ("error_WT", "a", stderr);
         fprintf (stderr, "Number of parameters is incorrect!\n");
         return EXIT_FAILURE;
     }
     else { 
-        freopen (argv[3], "w", stderr);
+        freopen (argv[4], "w", stderr);
         setbuf(stderr,NULL);
     }
 
-    strcpy (nFic, argv[1]);
-    key = (unsigned int) strtol (argv[2], &tinp, 0);
+    id = (unsigned int) strtol (argv[1], &tinp, 0);
+    if ((*tinp != '\0') || (id >= MAXWAITERS)) {
+        fprintf (stderr, "Waiter process identification is wrong!\n");
+        return EXIT_FAILURE;
+    }
+    strcpy (nFic, argv[2]);
+    key = (unsigned int) strtol (argv[3], &tinp, 0);
     if (*tinp != '\0') {
         fprintf (stderr, "Error on the access key communication!\n");
         return EXIT_FAILURE;
@@ -97,14 +113,29 @@ int main (int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    /* trace the semaphore the process is blocked on, for the watchdog of the main process */
+    if (sh->watchdog > 0) {
+        semBlockedOn (&sh->waiterBlockedOn[id].sindex);
+    }
+
+    /* record the contention statistics of the semaphores */
+    if (sh->semStatsOn) {
+        semStats (semStat (sh), semNu (sh) + 1);
+    }
+
     /* initialize random generator */
     srandom ((unsigned int) getpid ());              
 
-    /* simulation of the life cycle of the waiter */
-    int nReq=0;
+    /* buffer of the snapshots of the state */
+    snap = newLogRecord (sh->fSt.nGroups, sh->fSt.nWaiters, sh->fSt.nChefs);
+
+    /* open the logging session of this process */
+    sprintf (tag, "WT%02d", id);
+    openLogSession (nFic, &sh->logCtl, tag);
+
+    /* simulation of the life cycle of the waiter: the waiters serve two requests per group between them */
     request req;
-    while( nReq < sh->fSt.nGroups*2 ) {
-        req = waitForClientOrChef();
+    while( (req = waitForClientOrChef()).reqType != 0 ) {
         switch(req.reqType) {
             case FOODREQ:
                 informChef(req.reqGroup);
@@ -113,7 +144,21 @@ int main (int argc, char *argv[])
                 takeFoodToTable(req.reqGroup);
                 break;
         }
-        nReq++;
+    }
+
+    /* account for the adaptive downs on the mutex */
+    semAdaptiveStats (&fast, &spun, &blocked);
+    __atomic_fetch_add (&sh->mutexFast, fast, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexSpun, spun, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&sh->mutexBlocked, blocked, __ATOMIC_RELAXED);
+
+    /* close the logging session of this process */
+    closeLogSession ();
+
+    /* signal the end of the life cycle to the main process */
+    if (semUp (semgid, sh->rolesDone) == -1) {
+        perror ("error on the up operation for semaphore access (WT)");
+        return EXIT_FAILURE;
     }
 
     /* unmapping the shared region off the process address space */
@@ -128,70 +173,72 @@ int main (int argc, char *argv[])
 /**
  *  \brief waiter waits for next request 
  *
- *  Waiter updates state and waits for request from group or from chef, then reads request.
- *  The waiter should signal that new requests are possible.
+ *  Waiter updates state and waits for request from group or from chef, then takes it out of
+ *  the request queue of its zone or, if that one is empty, out of the queue of another zone
+ *  (the requests of a zone are served in arrival order).
+ *  The waiter that takes the last request of the simulation wakes up the other ones, which
+ *  then find no request left.
  *  The internal state should be saved.
  *
- *  \return request submitted by group or chef
+ *  \return request submitted by group or chef (reqType 0 once all requests are served)
  */
 static request waitForClientOrChef()
 {
-    request req;
-    bool foundRequest = false;
+    request req = { 0, 0 };
+    unsigned int total = 2 * sh->fSt.nGroups;  // requests of the simulation, two per group
+    int w, k;
+
+    // Stop once all requests are served
+    if (__atomic_load_n (&sh->waiterTaken, __ATOMIC_ACQUIRE) == total) {
+        return req;
+    }
 
-    if (semDown(semgid, sh->mutex) == -1) {
+    if (semDownAdaptive(semgid, sh->mutex) == -1) {
         perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
     // Update waiter's state to WAIT_FOR_REQUEST and save the state
-    sh->fSt.st.waiterStat = WAIT_FOR_REQUEST;
-    saveState(nFic, &sh->fSt);
+    sh->fSt.st.waiterStat[id] = WAIT_FOR_REQUEST;
+    snapshotState (snap, &sh->fSt);
 
     if (semUp(semgid, sh->mutex) == -1) {
         perror("error on the up operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
-    
-    // Signal readiness for new requests
-    if (semUp(semgid, sh->waiterRequestPossible) == -1) {
-        perror("error on the up operation for semaphore access (WT)");
+    writeSnapshot (nFic, snap);
+
+    // Wait for a request from a group or chef
+    if (semDown(semgid, sh->waiterRequest) == -1) {
+        perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
-    
-    // Wait for a request from a group or chef
-    while (!foundRequest) {
-        if (semDown(semgid, sh->mutex) == -1) {
-            perror("error on the down operation for semaphore access (WT)");
-            exit(EXIT_FAILURE);
-        }
 
-        // Check for group food requests
-        for (int i = 0; i < MAXGROUPS; i++) {
-            if (sh->fSt.st.groupStat[i] == FOOD_REQUEST) {
-                req.reqType = FOODREQ;
-                req.reqGroup = i;
-                foundRequest = true;
-                sh->fSt.st.groupStat[i] = WAIT_FOR_FOOD;
-                break;
-            }
-        }
+    // Woken up by the waiter that took the last request
+    if (__atomic_load_n (&sh->waiterTaken, __ATOMIC_ACQUIRE) == total) {
+        return req;
+    }
 
-        // Check for chef's food ready signal
-        if (!foundRequest && sh->fSt.waiterRequest.reqType == FOODREADY) {
-            for (int i = 0; i < MAXGROUPS; i++) {
-                if (sh->fSt.st.groupStat[i] == WAIT_FOR_FOOD) {
-                    req.reqType = FOODREADY;
-                    req.reqGroup = i;
-                    foundRequest = true;
-                    break;
-                }
-            }
+    // Take the oldest request of the own zone, or steal one from the other zones
+    // (the request the down stands for may not be published yet: look again)
+    for (k = 0; ; k++) {
+        if (k == sh->fSt.nWaiters) {
+            sched_yield ();
+            k = 0;
+        }
+        w = (id + k) % sh->fSt.nWaiters;
+        if (takeRequest (sh, &sh->waiterQueue[w], &req)) {
+            break;
         }
+    }
 
-        if (semUp(semgid, sh->mutex) == -1) {
-            perror("error on the up operation for semaphore access (WT)");
-            exit(EXIT_FAILURE);
+    // Wake up the other waiters once the last request is taken (the ones not blocked stop without a down)
+    if (__atomic_add_fetch (&sh->waiterTaken, 1, __ATOMIC_ACQ_REL) == total) {
+        for (k = 1; k < sh->fSt.nWaiters; k++) {
+            if (semUp (semgid, sh->waiterRequest) == -1) {
+                perror("error on the up operation for semaphore access (WT)");
+                exit(EXIT_FAILURE);
+            }
         }
     }
 
@@ -203,53 +250,36 @@ static request waitForClientOrChef()
 /**
  *  \brief waiter takes food order to chef 
  *
- *  Waiter updates state and then takes food request to chef.
+ *  Waiter updates state and then takes food request to the kitchen, where the first chef
+ *  that is free takes it (the order is queued, the chefs may be busy).
  *  Waiter should inform group that request is received.
- *  Waiter should wait for chef receiving request.
  *  The internal state should be saved.
  *
  */
 static void informChef (int n)
 {
-    if (semDown (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
+    if (semDownAdaptive (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
         perror ("error on the down operation for semaphore access (WT)");
         exit (EXIT_FAILURE);
     }
 
     // Update waiter's state to INFORM_CHEF and save the state
-    sh->fSt.st.waiterStat = INFORM_CHEF;
-    saveState(nFic, &sh->fSt);
+    sh->fSt.st.waiterStat[id] = INFORM_CHEF;
+    snapshotState (snap, &sh->fSt);
 
-    // Set request type and group ID for the chef
-    sh->fSt.waiterRequest.reqType = COOK;  // Request chef to cook
-    sh->fSt.waiterRequest.reqGroup = n;
+    // Place the food order of the group in the kitchen queue
+    postRequest (sh, &sh->chefQueue, FOODREQ, n);
 
+    int tableId = assignedTable (&sh->fSt)[n];  // Get the table number from the request
 
-    // Signal the chef that a request has been made
-    if (semUp(semgid, sh->waitOrder) == -1) {
+    // Signal the chefs that an order has been placed, the group that the request has been received
+    // and exit critical region
+    SEMOP leave[3] = {{ sh->waitOrder, 1 }, { requestReceived (sh, tableId), 1 }, { sh->mutex, 1 }};
+    if (semOps(semgid, leave, 3) == -1) {
         perror("error on the up operation for chef request semaphore (WT)");
         exit(EXIT_FAILURE);
     }
-
-    if (semUp (semgid, sh->mutex) == -1) {                                                  /* enter critical region */
-        perror ("error on the down operation for semaphore access (WT)");
-        exit (EXIT_FAILURE);
-    }
-
-
-    // Wait for chef to acknowledge the request
-    if (semDown(semgid, sh->orderReceived) == -1) {
-        perror("error on the down operation for chef response semaphore (WT)");
-        exit(EXIT_FAILURE);
-    }
-
-    int tableId = sh->fSt.assignedTable[n];  // Get the table number from the request
-    
-    // Signal the group that the request has been received
-    if (semUp(semgid, sh->requestReceived[tableId]) == -1) {
-        perror("error on the up operation for request semaphore (WT)");
-        exit(EXIT_FAILURE);
-    }
+    writeSnapshot (nFic, snap);
 }
 
 /**
@@ -262,39 +292,23 @@ static void informChef (int n)
  */
 static void takeFoodToTable(int n)
 {
-    if (semDown(semgid, sh->mutex) == -1) {
+    if (semDownAdaptive(semgid, sh->mutex) == -1) {
         perror("error on the down operation for semaphore access (WT)");
         exit(EXIT_FAILURE);
     }
 
-    sh->fSt.st.waiterStat = TAKE_TO_TABLE; 
-    saveState(nFic, &sh->fSt);
-
-    int tableId = sh->fSt.assignedTable[n];  // Get the table number from the request
-    if (semUp(semgid, sh->foodArrived[tableId]) == -1) {  // Signal the group that food is ready
-        perror("error on the up operation for food arrived semaphore (WT)");
-        exit(EXIT_FAILURE);
-    }
-
-    if (semUp(semgid, sh->mutex) == -1) {
-        perror("error on the up operation for semaphore access (WT)");
-        exit(EXIT_FAILURE);
-    }
+    sh->fSt.st.waiterStat[id] = TAKE_TO_TABLE; 
+    snapshotState (snap, &sh->fSt);
 
-    
-    if (semDown(semgid, sh->mutex) == -1) {
-        perror("error on the down operation for semaphore access (WT)");
-        exit(EXIT_FAILURE);
-    }
+    int tableId = assignedTable (&sh->fSt)[n];  // Get the table number from the request
 
-    sh->fSt.st.groupStat[n] = EAT;  // Update group's state to EAT
-    saveState(nFic, &sh->fSt);
-
-    if (semUp(semgid, sh->mutex) == -1) {
-        perror("error on the up operation for semaphore access (WT)");
+    // Signal the group that food is ready and exit critical region
+    SEMOP served[2] = {{ foodArrived (sh, tableId), 1 }, { sh->mutex, 1 }};
+    if (semOps(semgid, served, 2) == -1) {
+        perror("error on the up operation for food arrived semaphore (WT)");
         exit(EXIT_FAILURE);
     }
-
+    writeSnapshot (nFic, snap);
 }
 
 
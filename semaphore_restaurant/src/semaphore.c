@@ -9,20 +9,99 @@
  *     \li destruction of a previously created set of semaphores
  *     \li signalling start of operations
  *     \li <em>down</em> of a semaphore within the set
- *     \li <em>up</em> of a semaphore within the set.
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li several <em>down</em> and <em>up</em> operations within the set in a single call
+ *     \li non-blocking <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set with a timeout
+ *     \li tracing of the semaphore the calling process is blocked on
+ *     \li recording of the contention statistics of the semaphores (semaphoreCommon.c).
+ *
+ *  A set with more semaphores than a single SysV set may hold (SEMMSL, or <tt>SEMSET_SIZE</tt> if the file is
+ *  compiled with <tt>-DSEMSET_SIZE=n</tt>) is split among several SysV sets: the first one is created with the
+ *  creation key and holds the locations 0 .. size-1, the k-th one is created with the key whose most significant
+ *  byte is xored with k and holds the next size locations. The size is a multiple of SEMSET_ALIGN. The set
+ *  identifier returned to the caller is the one of the first set; the identifiers of the others are kept by the
+ *  process that created or connected to the set (and by its children).
  *
  *  \author António Rui Borges - October 1995
  */
 
+#define _GNU_SOURCE                                                          /* semtimedop */
+
 #include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <assert.h>
 
+#include "semaphore.h"
+#include "semaphoreCommon.h"
+
 /** \brief access permission: user r-w */
 #define  MASK           0600
 
+/** \brief maximum number of SysV sets a set of semaphores is split among */
+#define  SEMSETS_MAX    256
+
+/** \brief creation key of the k-th SysV set of a set created with key */
+#define  SEMSET_KEY(key,k)  (((key) == IPC_PRIVATE) ? IPC_PRIVATE : (key_t) ((key) ^ ((k) << 24)))
+
+/** \brief argument of semctl */
+union semun
+{ int val;
+  struct semid_ds *buf;
+  unsigned short *array;
+  struct seminfo *__buf;
+};
+
+/** \brief identifiers of the SysV sets of the set split among several of them (setId[0] is the set identifier) */
+static int setId[SEMSETS_MAX];
+
+/** \brief number of SysV sets (0 if the set is not split) */
+static unsigned int nSets = 0;
+
+/** \brief number of semaphores of each SysV set */
+static unsigned int setSize = 0;
+
+/** \brief location of the semaphore the process is blocked on (NULL if not traced) */
+static unsigned int *blockedOn = NULL;
+
+/** \brief maximum number of polling iterations of semDownAdaptive: each one is a semop system call */
+const int semSpinMax = 8;
+
+/* internal functions */
+
+/** \brief maximum number of semaphores of a SysV set, rounded down to a multiple of SEMSET_ALIGN */
+static unsigned int maxSetSize (void)
+{
+#ifdef SEMSET_SIZE
+  unsigned int n = SEMSET_SIZE;
+#else
+  struct seminfo info;
+  union semun arg = { .__buf = &info };
+  unsigned int n = (semctl (0, 0, IPC_INFO, arg) == -1) ? 250 : (unsigned int) info.semmsl;
+#endif
+
+  if (n < 2 * SEMSET_ALIGN)
+     n = 2 * SEMSET_ALIGN;
+  return n - n % SEMSET_ALIGN;
+}
+
+/** \brief SysV set holding semaphore sindex of set semgid, and its location there */
+static int locate (int semgid, unsigned int sindex, unsigned short *p_num)
+{
+  if ((nSets == 0) || (semgid != setId[0]))
+     { *p_num = (unsigned short) sindex;
+       return semgid;
+     }
+  assert((sindex / setSize) < nSets);
+  *p_num = (unsigned short) (sindex % setSize);
+  return setId[sindex / setSize];
+}
+
 /**
  *  \brief Creation of a set of semaphores.
  *
@@ -38,7 +117,29 @@
 
 int semCreate (int key, unsigned int snum)
 {
-  return semget ((key_t) key, snum+1, MASK | IPC_CREAT | IPC_EXCL);
+  unsigned int size = maxSetSize (),                                                      /* semaphores per SysV set */
+               n = snum / size + 1,                                                           /* number of SysV sets */
+               k;
+  int err;
+
+  if (snum < size)
+     return semget ((key_t) key, snum+1, MASK | IPC_CREAT | IPC_EXCL);
+  if (n > SEMSETS_MAX)
+     { errno = ENOSPC;
+       return -1;
+     }
+  for (k = 0; k < n; k++)
+    if ((setId[k] = semget (SEMSET_KEY (key, k), (k < n - 1) ? size : snum + 1 - k * size,
+                            MASK | IPC_CREAT | IPC_EXCL)) == -1)
+       { err = errno;
+         while (k > 0)
+           semctl (setId[--k], 0, IPC_RMID, NULL);
+         errno = err;
+         return -1;
+       }
+  nSets = n;
+  setSize = size;
+  return setId[0];
 }
 
 /**
@@ -56,12 +157,24 @@ int semConnect (int key)
 {
   int semgid;                                                                            /* semaphore set identifier */
   struct sembuf init[2] = {{ 0, -1, 0 }, {0, 1, 0}};                                     /* initialization operation */
+  struct semid_ds ds;
+  union semun arg = { .buf = &ds };
+  unsigned int n = 1;                                                                         /* number of SysV sets */
 
   if ((semgid = semget ((key_t) key, 1, MASK)) == -1)
      return -1;
-     else if (semop (semgid, init, 2) == -1)
-             return -1;
-             else return semgid;
+  if (semop (semgid, init, 2) == -1)
+     return -1;
+  setId[0] = semgid;
+  while ((n < SEMSETS_MAX) && ((setId[n] = semget (SEMSET_KEY (key, n), 0, MASK)) != -1))
+    n++;
+  if (n > 1)
+     { if (semctl (semgid, 0, IPC_STAT, arg) == -1)
+          return -1;
+       nSets = n;
+       setSize = (unsigned int) ds.sem_nsems;
+     }
+  return semgid;
 }
 
 /**
@@ -77,6 +190,12 @@ int semConnect (int key)
 
 int semDestroy (int semgid)
 {
+  if ((nSets != 0) && (semgid == setId[0]))
+     { while (nSets > 1)
+         if (semctl (setId[--nSets], 0, IPC_RMID, NULL) == -1)
+            return -1;
+       nSets = 0;
+     }
   return semctl (semgid, 0, IPC_RMID, NULL);
 }
 
@@ -113,10 +232,23 @@ int semSignal (int semgid)
 int semDown (int semgid, unsigned int sindex)
 {
   struct sembuf down = { 0, -1, 0 };                                                      /* specific down operation */
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
 
   assert(sindex>0);
-  down.sem_num = (unsigned short) sindex;
-  return semop (semgid, &down, 1);
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  semgid = locate (semgid, sindex, &down.sem_num);
+  if (blockedOn != NULL) *blockedOn = sindex;
+  status = semop (semgid, &down, 1);
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  return status;
 }
 
 /**
@@ -136,6 +268,145 @@ int semUp (int semgid, unsigned int sindex)
   struct sembuf up = { 0, 1, 0 };                                                           /* specific up operation */
 
   assert(sindex>0);
-  up.sem_num = (unsigned short) sindex;
+  semgid = locate (semgid, sindex, &up.sem_num);
   return semop (semgid, &up, 1);
 }
+
+/**
+ *  \brief Several <em>down</em> and <em>up</em> operations within the set in a single call.
+ *
+ *  The operations are carried out atomically, in a single system call: the calling process blocks until all the
+ *  <em>downs</em> can be done at once. When the semaphores are not in the same SysV set (see above), they are
+ *  carried out in order instead, each as a <tt>semDown</tt> or a <tt>semUp</tt>.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations
+ *  \param n number of operations (1 .. SEMOPS_MAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOps (int semgid, SEMOP ops[], unsigned int n)
+{
+  struct sembuf sops[SEMOPS_MAX];                                                            /* specific operations */
+  unsigned int i, downIndex = 0;
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status, id = -1;                                                                 /* SysV set of the operations */
+  bool split = false;                                                                /* operations on different sets */
+
+  assert((n>0) && (n<=SEMOPS_MAX));
+  for (i = 0; i < n; i++)
+  { assert(ops[i].sindex>0);
+    status = locate (semgid, ops[i].sindex, &sops[i].sem_num);
+    if (i == 0)
+       id = status;
+       else if (status != id)
+               split = true;
+    sops[i].sem_op = (short) ops[i].op;
+    sops[i].sem_flg = 0;
+    if ((ops[i].op < 0) && (downIndex == 0))
+       downIndex = ops[i].sindex;
+  }
+  if (split)
+     { for (i = 0; i < n; i++)
+         if (((ops[i].op < 0) ? semDown (semgid, ops[i].sindex) : semUp (semgid, ops[i].sindex)) == -1)
+            return -1;
+       return 0;
+     }
+  if (semAccounting () && (downIndex != 0))
+     { for (i = 0; i < n; i++)
+         sops[i].sem_flg = IPC_NOWAIT;
+       if ((status = semop (id, sops, n)) == 0)
+          { semAccount (downIndex, 0);
+            return 0;
+          }
+       if (errno != EAGAIN)
+          return -1;
+       for (i = 0; i < n; i++)
+         sops[i].sem_flg = 0;
+       t0 = semNowNs ();
+     }
+  if ((blockedOn != NULL) && (downIndex != 0)) *blockedOn = downIndex;
+  status = semop (id, sops, n);
+  if ((blockedOn != NULL) && (downIndex != 0)) *blockedOn = 0;
+  if ((status == 0) && semAccounting () && (downIndex != 0)) semAccount (downIndex, t0);
+  return status;
+}
+
+/**
+ *  \brief Non-blocking <em>down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is in <em>red state</em> (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semTryDown (int semgid, unsigned int sindex)
+{
+  struct sembuf down = { 0, -1, IPC_NOWAIT };                                /* specific non-blocking down operation */
+
+  assert(sindex>0);
+  if (semop (locate (semgid, sindex, &down.sem_num), &down, 1) == -1)
+     return -1;
+  if (semAccounting ()) semAccount (sindex, 0);
+  return 0;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, waiting at most a given time.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is still in <em>red state</em> when the time expires (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param timeout maximum waiting time (ms)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int timeout)
+{
+  struct sembuf down = { 0, -1, 0 };                                                      /* specific down operation */
+  struct timespec ts = { timeout / 1000, (timeout % 1000) * 1000000L };                             /* waiting time */
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
+
+  assert(sindex>0);
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  semgid = locate (semgid, sindex, &down.sem_num);
+  if (blockedOn != NULL) *blockedOn = sindex;
+  status = semtimedop (semgid, &down, 1, &ts);
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  return status;
+}
+
+/**
+ *  \brief Tracing of the semaphore the calling process is blocked on.
+ *
+ *  From now on, every <em>down</em> of the process stores the semaphore location in <tt>*p_where</tt> before it
+ *  may block and 0 after it completes, so that a watchdog can tell what a stalled process is waiting for.
+ *
+ *  \param p_where pointer to the location (usually in shared memory) that holds the semaphore location, or NULL
+ *         to stop tracing
+ */
+
+void semBlockedOn (unsigned int *p_where)
+{
+  blockedOn = p_where;
+}
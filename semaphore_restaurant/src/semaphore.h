@@ -9,7 +9,12 @@
  *     \li destruction of a previously created set of semaphores
  *     \li signalling start of operations
  *     \li <em>down</em> of a semaphore within the set
- *     \li <em>up</em> of a semaphore within the set.
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li several <em>down</em> and <em>up</em> operations within the set in a single call
+ *     \li non-blocking <em>down</em> and adaptive (spin, then block) <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set with a timeout
+ *     \li tracing of the semaphore the calling process is blocked on
+ *     \li recording of the contention statistics of the semaphores.
  *
  *  \author António Rui Borges - October 1995
  */
@@ -17,6 +22,39 @@
 #ifndef SEMAPHORE_H_
 #define SEMAPHORE_H_
 
+/** \brief maximum number of operations of a single <tt>semOps</tt> call */
+#define  SEMOPS_MAX     8
+
+/**
+ *  \brief the SEMSET_ALIGN locations starting on a multiple of SEMSET_ALIGN are always in the same SysV set, when
+ *  a large set is split among several of them (their operations in a single <tt>semOps</tt> call are atomic)
+ */
+#define  SEMSET_ALIGN   4
+
+/**
+ *  \brief Definition of an operation of <tt>semOps</tt>.
+ */
+typedef struct {
+    /** \brief semaphore location in the set (1 .. snum) */
+    unsigned int sindex;
+    /** \brief operation: 1 for <em>up</em>, -1 for <em>down</em> */
+    int op;
+} SEMOP;
+
+/**
+ *  \brief Definition of the contention statistics of a semaphore.
+ */
+typedef struct {
+    /** \brief number of <em>downs</em> */
+    unsigned long nDown;
+    /** \brief number of <em>downs</em> that blocked */
+    unsigned long nBlocked;
+    /** \brief total time blocked (ns) */
+    unsigned long long blockedNs;
+    /** \brief maximum time blocked in a single <em>down</em> (ns) */
+    unsigned long long maxBlockedNs;
+} SEMSTAT;
+
 /**
  *  \brief Creation of a set of semaphores.
  *
@@ -99,4 +137,118 @@ extern int semDown (int semgid, unsigned int sindex);
 
 extern int semUp (int semgid, unsigned int sindex);
 
+/**
+ *  \brief Several <em>down</em> and <em>up</em> operations within the set in a single call.
+ *
+ *  With SysV semaphores, the operations are carried out atomically, in a single system call: the calling process
+ *  blocks until all the <em>downs</em> can be done at once, as long as the semaphores are in the same SysV set
+ *  (see SEMSET_ALIGN). The other backends carry them out in order, which is equivalent to the sequence of
+ *  <tt>semDown</tt> and <tt>semUp</tt> calls it replaces.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations
+ *  \param n number of operations (1 .. SEMOPS_MAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semOps (int semgid, SEMOP ops[], unsigned int n);
+
+/**
+ *  \brief Non-blocking <em>down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is in <em>red state</em> (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semTryDown (int semgid, unsigned int sindex);
+
+/**
+ *  \brief Maximum number of polling iterations of <tt>semDownAdaptive</tt> with this backend.
+ *
+ *  A poll only reads the semaphore value in shared memory with the futex and POSIX backends; with SysV semaphores
+ *  it is a <tt>semop</tt> system call, so that backend allows a few polls only.
+ */
+
+extern const int semSpinMax;
+
+/**
+ *  \brief Adaptive <em>down</em> of a semaphore within the set.
+ *
+ *  Meant for semaphores held for very short periods (a mutex): the semaphore is polled with <tt>semTryDown</tt>
+ *  for a bounded number of iterations before falling back to the blocking <tt>semDown</tt>. The bound is tuned
+ *  for each semaphore from the number of iterations that were needed before; there is no spinning on a single
+ *  processor host.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semDownAdaptive (int semgid, unsigned int sindex);
+
+/**
+ *  \brief Counters of the adaptive <em>downs</em> done by the calling process.
+ *
+ *  \param p_fast pointer to the location where the number of <em>downs</em> completed at the first poll is stored
+ *  \param p_spun pointer to the location where the number of <em>downs</em> completed while spinning is stored
+ *  \param p_blocked pointer to the location where the number of <em>downs</em> that had to block is stored
+ */
+
+extern void semAdaptiveStats (unsigned long *p_fast, unsigned long *p_spun, unsigned long *p_blocked);
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, waiting at most a given time.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is still in <em>red state</em> when the time expires (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param timeout maximum waiting time (ms)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern int semDownTimed (int semgid, unsigned int sindex, unsigned int timeout);
+
+/**
+ *  \brief Tracing of the semaphore the calling process is blocked on.
+ *
+ *  From now on, every <em>down</em> of the process stores the semaphore location in <tt>*p_where</tt> before it
+ *  may block and 0 after it completes, so that a watchdog can tell what a stalled process is waiting for.
+ *
+ *  \param p_where pointer to the location (usually in shared memory) that holds the semaphore location, or NULL
+ *         to stop tracing
+ */
+
+extern void semBlockedOn (unsigned int *p_where);
+
+/**
+ *  \brief Recording of the contention statistics of the semaphores.
+ *
+ *  From now on, every <em>down</em> of the process done with <tt>semDown</tt>, <tt>semTryDown</tt> (when it
+ *  succeeds), <tt>semDownAdaptive</tt>, <tt>semDownTimed</tt> (when it succeeds) or <tt>semOps</tt> (the first
+ *  <em>down</em> of the call) is accounted for in <tt>p_stat[sindex]</tt>, updated atomically so that the array
+ *  may be shared by several processes.
+ *  A <em>down</em> blocks when the semaphore is in <em>red state</em> at the time of the call.
+ *
+ *  \param p_stat pointer to the array of statistics, indexed by semaphore location, or NULL to stop recording
+ *  \param n number of elements of the array
+ */
+
+extern void semStats (SEMSTAT *p_stat, unsigned int n);
+
 #endif /* SEMAPHORE_H_ */
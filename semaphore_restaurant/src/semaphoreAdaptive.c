@@ -0,0 +1,118 @@
+/**
+ *  \file semaphoreAdaptive.c (implementation file)
+ *
+ *  \brief Semaphore management (adaptive down).
+ *
+ *  Operations defined on semaphores, on top of any backend (semaphore.c, semaphoreFutex.c, semaphorePosix.c):
+ *     \li adaptive (spin, then block) <em>down</em> of a semaphore within the set
+ *     \li counters of the adaptive <em>downs</em> done by the calling process.
+ *
+ *  The number of polling iterations allowed for a semaphore follows the average number of iterations that were
+ *  needed to get it while spinning (as glibc adaptive mutexes do): twice that average plus a margin, bounded by
+ *  the <tt>semSpinMax</tt> of the backend. With the futex and POSIX backends, polling only reads the semaphore
+ *  value in shared memory; with SysV semaphores, each poll is a non-blocking <tt>semop</tt> system call, so that
+ *  the bound is kept to a few polls.
+ *
+ *  The <em>downs</em> that get the semaphore at the first poll (uncontended) are counted apart from the ones that
+ *  got it while spinning, which are the ones spinning saved from blocking.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "semaphore.h"
+
+/** \brief polling iterations allowed on top of twice the average */
+#define  SPIN_MARGIN    10
+
+/** \brief number of semaphores whose average is tracked (the others use semSpinMax) */
+#define  SPIN_TRACKED   64
+
+/** \brief average number of polling iterations needed to get each semaphore */
+static int spinAvg[SPIN_TRACKED];
+
+/** \brief number of downs completed at the first poll */
+static unsigned long nFast = 0;
+
+/** \brief number of downs completed while spinning */
+static unsigned long nSpun = 0;
+
+/** \brief number of downs that had to block */
+static unsigned long nBlocked = 0;
+
+/** \brief -1 until known; then 1 on a multiprocessor host, 0 otherwise */
+static int multiCore = -1;
+
+/** \brief hint to the processor that the caller is busy waiting */
+static inline void cpuRelax (void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+  __builtin_ia32_pause ();
+#elif defined (__aarch64__)
+  __asm__ volatile ("yield" ::: "memory");
+#else
+  __asm__ volatile ("" ::: "memory");
+#endif
+}
+
+/**
+ *  \brief Adaptive <em>down</em> of a semaphore within the set.
+ *
+ *  Meant for semaphores held for very short periods (a mutex): the semaphore is polled with <tt>semTryDown</tt>
+ *  for a bounded number of iterations before falling back to the blocking <tt>semDown</tt>. The bound is tuned
+ *  for each semaphore from the number of iterations that were needed before; there is no spinning on a single
+ *  processor host.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownAdaptive (int semgid, unsigned int sindex)
+{
+  int limit, i;
+
+  if (multiCore == -1)
+     multiCore = (sysconf (_SC_NPROCESSORS_ONLN) > 1);
+  limit = !multiCore ? 1 : (sindex < SPIN_TRACKED) ? 2 * spinAvg[sindex] + SPIN_MARGIN : semSpinMax;
+  if (limit > semSpinMax)
+     limit = semSpinMax;
+
+  for (i = 0; i < limit; i++)
+  { if (semTryDown (semgid, sindex) == 0)
+       { if (sindex < SPIN_TRACKED)
+            spinAvg[sindex] += (i - spinAvg[sindex]) / 8;
+         if (i == 0)
+            nFast += 1;
+            else nSpun += 1;
+         return 0;
+       }
+    if (errno != EAGAIN)
+       return -1;
+    cpuRelax ();
+  }
+
+  if (sindex < SPIN_TRACKED)
+     spinAvg[sindex] += (limit - spinAvg[sindex]) / 8;
+  nBlocked += 1;
+  return semDown (semgid, sindex);
+}
+
+/**
+ *  \brief Counters of the adaptive <em>downs</em> done by the calling process.
+ *
+ *  \param p_fast pointer to the location where the number of <em>downs</em> completed at the first poll is stored
+ *  \param p_spun pointer to the location where the number of <em>downs</em> completed while spinning is stored
+ *  \param p_blocked pointer to the location where the number of <em>downs</em> that had to block is stored
+ */
+
+void semAdaptiveStats (unsigned long *p_fast, unsigned long *p_spun, unsigned long *p_blocked)
+{
+  *p_fast = nFast;
+  *p_spun = nSpun;
+  *p_blocked = nBlocked;
+}
@@ -0,0 +1,158 @@
+/**
+ *  \file semaphoreCommon.c (implementation file)
+ *
+ *  \brief Semaphore management (internals shared by the backends).
+ *
+ *  Operations defined on semaphores, shared by the backends (semaphore.c, semaphoreFutex.c, semaphorePosix.c):
+ *     \li recording of the contention statistics of the semaphores
+ *     \li accounting of the <em>downs</em> in the contention statistics
+ *     \li mapping of a set of semaphores kept in a shared memory segment of its own (futex and POSIX backends).
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "semaphore.h"
+#include "semaphoreCommon.h"
+
+/** \brief maximum number of semaphore sets a process can be connected to */
+#define  MAXSETS        4
+
+/** \brief sets the process is connected to: identifier and mapping address */
+static struct {
+    int semgid;
+    void *set;
+} conn[MAXSETS];
+
+/** \brief number of sets the process is connected to */
+static int nConn = 0;
+
+/** \brief contention statistics of the semaphores (NULL if not recorded) */
+static SEMSTAT *stats = NULL;
+
+/** \brief number of semaphores with statistics */
+static unsigned int nStats = 0;
+
+/**
+ *  \brief Recording of the contention statistics of the semaphores.
+ *
+ *  From now on, every <em>down</em> of the process done with <tt>semDown</tt>, <tt>semTryDown</tt> (when it
+ *  succeeds), <tt>semDownAdaptive</tt>, <tt>semDownTimed</tt> (when it succeeds) or <tt>semOps</tt> (the first
+ *  <em>down</em> of the call) is accounted for in <tt>p_stat[sindex]</tt>, updated atomically so that the array
+ *  may be shared by several processes.
+ *  A <em>down</em> blocks when the semaphore is in <em>red state</em> at the time of the call.
+ *
+ *  \param p_stat pointer to the array of statistics, indexed by semaphore location, or NULL to stop recording
+ *  \param n number of elements of the array
+ */
+
+void semStats (SEMSTAT *p_stat, unsigned int n)
+{
+  stats = p_stat;
+  nStats = (p_stat != NULL) ? n : 0;
+}
+
+/**
+ *  \brief Whether the <em>downs</em> of the process are accounted for in the contention statistics.
+ *
+ *  \return true, if <tt>semStats</tt> was called with an array of statistics
+ */
+
+bool semAccounting (void)
+{
+  return stats != NULL;
+}
+
+/**
+ *  \brief Current value of the monotonic clock.
+ *
+ *  \return time in ns
+ */
+
+unsigned long long semNowNs (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ *  \brief Accounting for a <em>down</em> in the contention statistics.
+ *
+ *  \param sindex semaphore location in the set (not accounted for beyond the elements of the array)
+ *  \param t0 time the <em>down</em> started blocking (<tt>semNowNs</tt>), or 0 if it did not block
+ */
+
+void semAccount (unsigned int sindex, unsigned long long t0)
+{
+  SEMSTAT *st;
+  unsigned long long d, max;
+
+  if (sindex >= nStats)
+     return;
+  st = &stats[sindex];
+  __atomic_fetch_add (&st->nDown, 1, __ATOMIC_RELAXED);
+  if (t0 == 0)
+     return;
+  d = semNowNs () - t0;
+  __atomic_fetch_add (&st->nBlocked, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&st->blockedNs, d, __ATOMIC_RELAXED);
+  max = __atomic_load_n (&st->maxBlockedNs, __ATOMIC_RELAXED);
+  while ((d > max) && !__atomic_compare_exchange_n (&st->maxBlockedNs, &max, d, false, __ATOMIC_RELAXED,
+                                                    __ATOMIC_RELAXED));
+}
+
+/**
+ *  \brief Mapping of a set kept in a shared memory segment onto the process address space.
+ *
+ *  The segment is only attached the first time; the next calls return the same address.
+ *
+ *  \param semgid set identifier (identifier of the segment)
+ *
+ *  \return address of the set, upon success
+ *  \return NULL, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+void *semAttachSet (int semgid)
+{
+  void *addr;
+  int n;
+
+  for (n = 0; n < nConn; n++)
+    if (conn[n].semgid == semgid)
+       return conn[n].set;
+  if (nConn == MAXSETS)
+     { errno = ENOMEM;
+       return NULL;
+     }
+  if ((addr = shmat (semgid, NULL, 0)) == (void *) -1)
+     return NULL;
+  conn[nConn].semgid = semgid;
+  conn[nConn].set = addr;
+  nConn += 1;
+  return addr;
+}
+
+/**
+ *  \brief Unmapping of a set kept in a shared memory segment off the process address space.
+ *
+ *  \param semgid set identifier (identifier of the segment)
+ */
+
+void semDetachSet (int semgid)
+{
+  int n;
+
+  for (n = 0; n < nConn; n++)
+    if (conn[n].semgid == semgid)
+       { shmdt (conn[n].set);
+         conn[n] = conn[--nConn];
+         return;
+       }
+}
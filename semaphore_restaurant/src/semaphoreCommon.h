@@ -0,0 +1,62 @@
+/**
+ *  \file semaphoreCommon.h (interface file)
+ *
+ *  \brief Semaphore management (internals shared by the backends).
+ *
+ *  Operations shared by semaphore.c, semaphoreFutex.c and semaphorePosix.c, not meant for the entities:
+ *     \li accounting of the <em>downs</em> in the contention statistics (<tt>semStats</tt>)
+ *     \li mapping of a set of semaphores kept in a shared memory segment of its own (futex and POSIX backends).
+ */
+
+#ifndef SEMAPHORECOMMON_H_
+#define SEMAPHORECOMMON_H_
+
+#include <stdbool.h>
+
+/**
+ *  \brief Whether the <em>downs</em> of the process are accounted for in the contention statistics.
+ *
+ *  \return true, if <tt>semStats</tt> was called with an array of statistics
+ */
+
+extern bool semAccounting (void);
+
+/**
+ *  \brief Current value of the monotonic clock.
+ *
+ *  \return time in ns
+ */
+
+extern unsigned long long semNowNs (void);
+
+/**
+ *  \brief Accounting for a <em>down</em> in the contention statistics.
+ *
+ *  \param sindex semaphore location in the set (not accounted for beyond the elements of the array)
+ *  \param t0 time the <em>down</em> started blocking (<tt>semNowNs</tt>), or 0 if it did not block
+ */
+
+extern void semAccount (unsigned int sindex, unsigned long long t0);
+
+/**
+ *  \brief Mapping of a set kept in a shared memory segment onto the process address space.
+ *
+ *  The segment is only attached the first time; the next calls return the same address.
+ *
+ *  \param semgid set identifier (identifier of the segment)
+ *
+ *  \return address of the set, upon success
+ *  \return NULL, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+extern void *semAttachSet (int semgid);
+
+/**
+ *  \brief Unmapping of a set kept in a shared memory segment off the process address space.
+ *
+ *  \param semgid set identifier (identifier of the segment)
+ */
+
+extern void semDetachSet (int semgid);
+
+#endif /* SEMAPHORECOMMON_H_ */
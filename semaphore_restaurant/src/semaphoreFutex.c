@@ -0,0 +1,410 @@
+/**
+ *  \file semaphoreFutex.c (implementation file)
+ *
+ *  \brief Semaphore management (futex backend).
+ *
+ *  Operations defined on semaphores:
+ *     \li creation of a set of semaphores
+ *     \li connection to a previously created set of semaphores
+ *     \li destruction of a previously created set of semaphores
+ *     \li signalling start of operations
+ *     \li <em>down</em> of a semaphore within the set
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li several <em>down</em> and <em>up</em> operations within the set in a single call
+ *     \li non-blocking <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set with a timeout
+ *     \li tracing of the semaphore the calling process is blocked on
+ *     \li recording of the contention statistics of the semaphores (semaphoreCommon.c).
+ *
+ *  Drop-in replacement of semaphore.c (same interface, semaphore.h), selected at build time with
+ *  <tt>make futex</tt>. The semaphore values are kept as atomic counters in a shared memory segment of
+ *  their own: <em>down</em> and <em>up</em> complete in user space when no process has to block, and the
+ *  kernel is only entered (<tt>futex</tt> system call) to sleep on a red semaphore or to wake a sleeper.
+ *  The set identifier is the identifier of that segment, mapped by semaphoreCommon.c.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <assert.h>
+
+#include "semaphore.h"
+#include "semaphoreCommon.h"
+
+/** \brief access permission: user r-w */
+#define  MASK           0600
+
+/** \brief the segment key is derived from the creation key, so as not to clash with the shared data segment */
+#define  FUTEX_KEY(key) ((key) ^ 0x40000000)
+
+/**
+ *  \brief Definition of a semaphore.
+ */
+typedef struct {
+    /** \brief value (futex word) */
+    int val;
+    /** \brief number of processes sleeping, or about to sleep, on the semaphore */
+    int nWait;
+} FSEM;
+
+/**
+ *  \brief Definition of a set of semaphores, as stored in its shared memory segment.
+ */
+typedef struct {
+    /** \brief number of semaphores in the set, including the start of operations one (index 0) */
+    unsigned int snum;
+    /** \brief semaphores */
+    FSEM sem[];
+} FSEM_SET;
+
+/** \brief location of the semaphore the process is blocked on (NULL if not traced) */
+static unsigned int *blockedOn = NULL;
+
+/** \brief maximum number of polling iterations of semDownAdaptive: each one reads the value in shared memory */
+const int semSpinMax = 1000;
+
+/* internal functions */
+
+static int futex (int *uaddr, int op, int val, const struct timespec *timeout)
+{
+  return (int) syscall (SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+
+/** \brief <em>down</em> of semaphore sindex: user space decrement, sleeping in the kernel while the value is 0,
+ *         until the (CLOCK_MONOTONIC) deadline if there is one */
+static int fsemDown (FSEM_SET *set, unsigned int sindex, const struct timespec *deadline)
+{
+  FSEM *s = &set->sem[sindex];
+  struct timespec now, left;
+  int v, status;
+
+  for (;;)
+  { v = __atomic_load_n (&s->val, __ATOMIC_RELAXED);
+    while (v > 0)
+      if (__atomic_compare_exchange_n (&s->val, &v, v - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+         return 0;
+    if (deadline != NULL)
+       { clock_gettime (CLOCK_MONOTONIC, &now);
+         left.tv_sec = deadline->tv_sec - now.tv_sec;
+         left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+         if (left.tv_nsec < 0)
+            { left.tv_sec -= 1;
+              left.tv_nsec += 1000000000L;
+            }
+         if (left.tv_sec < 0)
+            { errno = EAGAIN;
+              return -1;
+            }
+       }
+    __atomic_fetch_add (&s->nWait, 1, __ATOMIC_SEQ_CST);
+    status = futex (&s->val, FUTEX_WAIT, 0, (deadline != NULL) ? &left : NULL);
+    __atomic_fetch_sub (&s->nWait, 1, __ATOMIC_RELAXED);
+    if ((status == -1) && (errno == EINTR))
+       return -1;
+  }
+}
+
+/** \brief <em>up</em> of semaphore sindex: user space increment, entering the kernel only if there are sleepers */
+static int fsemUp (FSEM_SET *set, unsigned int sindex)
+{
+  FSEM *s = &set->sem[sindex];
+
+  __atomic_fetch_add (&s->val, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&s->nWait, __ATOMIC_SEQ_CST) > 0)
+     if (futex (&s->val, FUTEX_WAKE, 1, NULL) == -1)
+        return -1;
+  return 0;
+}
+
+/**
+ *  \brief Creation of a set of semaphores.
+ *
+ *  All semaphores in the set will be in set to <em>red state</em> upon creation.
+ *  The function fails if there is already a semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *  \param snum number of semaphores in the set (>= 1)
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semCreate (int key, unsigned int snum)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  FSEM_SET *set;                                                                            /* mapping of the set */
+  key_t fkey = (key == IPC_PRIVATE) ? IPC_PRIVATE : (key_t) FUTEX_KEY (key);
+
+  if ((semgid = shmget (fkey, sizeof (FSEM_SET) + (snum + 1) * sizeof (FSEM), MASK | IPC_CREAT | IPC_EXCL)) == -1)
+     return -1;
+  if ((set = semAttachSet (semgid)) == NULL)
+     { shmctl (semgid, IPC_RMID, NULL);
+       return -1;
+     }
+  memset (set->sem, 0, (snum + 1) * sizeof (FSEM));
+  set->snum = snum + 1;
+  return semgid;
+}
+
+/**
+ *  \brief Connection to a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semConnect (int key)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  FSEM_SET *set;                                                                            /* mapping of the set */
+
+  if ((semgid = shmget ((key_t) FUTEX_KEY (key), 0, MASK)) == -1)
+     return -1;
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if ((fsemDown (set, 0, NULL) == -1) || (fsemUp (set, 0) == -1))             /* wait for the start of operations */
+     return -1;
+  return semgid;
+}
+
+/**
+ *  \brief Destruction of a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDestroy (int semgid)
+{
+  if (shmctl (semgid, IPC_RMID, NULL) == -1)
+     return -1;
+  semDetachSet (semgid);
+  return 0;
+}
+
+/**
+ *  \brief Signalling start of operations upon initialization of shared data structures.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSignal (int semgid)
+{
+  FSEM_SET *set;                                                                            /* mapping of the set */
+
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  return fsemUp (set, 0);
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDown (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;                                                                            /* mapping of the set */
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  if (blockedOn != NULL) *blockedOn = sindex;
+  status = fsemDown (set, sindex, NULL);
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  return status;
+}
+
+/**
+ *  \brief <em>Up</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semUp (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;                                                                            /* mapping of the set */
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  return fsemUp (set, sindex);
+}
+
+/**
+ *  \brief Several <em>down</em> and <em>up</em> operations within the set in a single call.
+ *
+ *  The operations are carried out in order, as the sequence of <tt>semDown</tt> and <tt>semUp</tt> calls it replaces
+ *  (this backend has no atomic multi-semaphore operation).
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations
+ *  \param n number of operations (1 .. SEMOPS_MAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOps (int semgid, SEMOP ops[], unsigned int n)
+{
+  unsigned int i;
+
+  assert((n>0) && (n<=SEMOPS_MAX));
+  for (i = 0; i < n; i++)
+    if (((ops[i].op < 0) ? semDown (semgid, ops[i].sindex) : semUp (semgid, ops[i].sindex)) == -1)
+       return -1;
+  return 0;
+}
+
+/**
+ *  \brief Non-blocking <em>down</em> of a semaphore within the set.
+ *
+ *  The semaphore value is only read and updated in user space.
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is in <em>red state</em> (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semTryDown (int semgid, unsigned int sindex)
+{
+  FSEM_SET *set;                                                                            /* mapping of the set */
+  int v;
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  v = __atomic_load_n (&set->sem[sindex].val, __ATOMIC_RELAXED);
+  while (v > 0)
+    if (__atomic_compare_exchange_n (&set->sem[sindex].val, &v, v - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+       { if (semAccounting ()) semAccount (sindex, 0);
+         return 0;
+       }
+  errno = EAGAIN;
+  return -1;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, waiting at most a given time.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is still in <em>red state</em> when the time expires (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param timeout maximum waiting time (ms)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int timeout)
+{
+  FSEM_SET *set;                                                                            /* mapping of the set */
+  struct timespec deadline;
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  clock_gettime (CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += timeout / 1000;
+  deadline.tv_nsec += (timeout % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+     { deadline.tv_sec += 1;
+       deadline.tv_nsec -= 1000000000L;
+     }
+  if (blockedOn != NULL) *blockedOn = sindex;
+  status = fsemDown (set, sindex, &deadline);
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  return status;
+}
+
+/**
+ *  \brief Tracing of the semaphore the calling process is blocked on.
+ *
+ *  From now on, every <em>down</em> of the process stores the semaphore location in <tt>*p_where</tt> before it
+ *  may block and 0 after it completes, so that a watchdog can tell what a stalled process is waiting for.
+ *
+ *  \param p_where pointer to the location (usually in shared memory) that holds the semaphore location, or NULL
+ *         to stop tracing
+ */
+
+void semBlockedOn (unsigned int *p_where)
+{
+  blockedOn = p_where;
+}
@@ -0,0 +1,355 @@
+/**
+ *  \file semaphorePosix.c (implementation file)
+ *
+ *  \brief Semaphore management (POSIX backend).
+ *
+ *  Operations defined on semaphores:
+ *     \li creation of a set of semaphores
+ *     \li connection to a previously created set of semaphores
+ *     \li destruction of a previously created set of semaphores
+ *     \li signalling start of operations
+ *     \li <em>down</em> of a semaphore within the set
+ *     \li <em>up</em> of a semaphore within the set
+ *     \li several <em>down</em> and <em>up</em> operations within the set in a single call
+ *     \li non-blocking <em>down</em> of a semaphore within the set
+ *     \li <em>down</em> of a semaphore within the set with a timeout
+ *     \li tracing of the semaphore the calling process is blocked on
+ *     \li recording of the contention statistics of the semaphores (semaphoreCommon.c).
+ *
+ *  Drop-in replacement of semaphore.c (same interface, semaphore.h), selected at build time with
+ *  <tt>make posix</tt>. The semaphores are process-shared POSIX semaphores (<tt>sem_t</tt>, <tt>pshared</tt> = 1)
+ *  kept in a shared memory segment of their own, since the interface does not give access to the shared data
+ *  region: <tt>sem_wait</tt> and <tt>sem_post</tt> avoid the kernel when no process has to block.
+ *  The set identifier is the identifier of that segment, mapped by semaphoreCommon.c.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <semaphore.h>
+#include <assert.h>
+
+#include "semaphore.h"
+#include "semaphoreCommon.h"
+
+/** \brief access permission: user r-w */
+#define  MASK           0600
+
+/** \brief the segment key is derived from the creation key, so as not to clash with the shared data segment */
+#define  POSIX_KEY(key) ((key) ^ 0x20000000)
+
+/**
+ *  \brief Definition of a set of semaphores, as stored in its shared memory segment.
+ */
+typedef struct {
+    /** \brief number of semaphores in the set, including the start of operations one (index 0) */
+    unsigned int snum;
+    /** \brief semaphores */
+    sem_t sem[];
+} PSEM_SET;
+
+/** \brief location of the semaphore the process is blocked on (NULL if not traced) */
+static unsigned int *blockedOn = NULL;
+
+/** \brief maximum number of polling iterations of semDownAdaptive: each one reads the value in shared memory */
+const int semSpinMax = 1000;
+
+/**
+ *  \brief Creation of a set of semaphores.
+ *
+ *  All semaphores in the set will be in set to <em>red state</em> upon creation.
+ *  The function fails if there is already a semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *  \param snum number of semaphores in the set (>= 1)
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semCreate (int key, unsigned int snum)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  PSEM_SET *set;                                                                            /* mapping of the set */
+  key_t fkey = (key == IPC_PRIVATE) ? IPC_PRIVATE : (key_t) POSIX_KEY (key);
+  unsigned int n;
+
+  if ((semgid = shmget (fkey, sizeof (PSEM_SET) + (snum + 1) * sizeof (sem_t), MASK | IPC_CREAT | IPC_EXCL)) == -1)
+     return -1;
+  if ((set = semAttachSet (semgid)) == NULL)
+     { shmctl (semgid, IPC_RMID, NULL);
+       return -1;
+     }
+  for (n = 0; n <= snum; n++)
+    if (sem_init (&set->sem[n], 1, 0) == -1)
+       { semDetachSet (semgid);
+         shmctl (semgid, IPC_RMID, NULL);
+         return -1;
+       }
+  set->snum = snum + 1;
+  return semgid;
+}
+
+/**
+ *  \brief Connection to a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *
+ *  \return set identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semConnect (int key)
+{
+  int semgid;                                                                            /* semaphore set identifier */
+  PSEM_SET *set;                                                                            /* mapping of the set */
+
+  if ((semgid = shmget ((key_t) POSIX_KEY (key), 0, MASK)) == -1)
+     return -1;
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if ((sem_wait (&set->sem[0]) == -1) || (sem_post (&set->sem[0]) == -1))  /* wait for the start of operations */
+     return -1;
+  return semgid;
+}
+
+/**
+ *  \brief Destruction of a previously created set of semaphores.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDestroy (int semgid)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+  unsigned int n;
+
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  for (n = 0; n < set->snum; n++)
+    sem_destroy (&set->sem[n]);
+  if (shmctl (semgid, IPC_RMID, NULL) == -1)
+     return -1;
+  semDetachSet (semgid);
+  return 0;
+}
+
+/**
+ *  \brief Signalling start of operations upon initialization of shared data structures.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semSignal (int semgid)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  return sem_post (&set->sem[0]);
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDown (int semgid, unsigned int sindex)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  if (blockedOn != NULL) *blockedOn = sindex;
+  status = sem_wait (&set->sem[sindex]);
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  return status;
+}
+
+/**
+ *  \brief <em>Up</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semUp (int semgid, unsigned int sindex)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  return sem_post (&set->sem[sindex]);
+}
+
+/**
+ *  \brief Several <em>down</em> and <em>up</em> operations within the set in a single call.
+ *
+ *  The operations are carried out in order, as the sequence of <tt>semDown</tt> and <tt>semUp</tt> calls it replaces
+ *  (this backend has no atomic multi-semaphore operation).
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>.
+ *
+ *  \param semgid set identifier
+ *  \param ops operations
+ *  \param n number of operations (1 .. SEMOPS_MAX)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semOps (int semgid, SEMOP ops[], unsigned int n)
+{
+  unsigned int i;
+
+  assert((n>0) && (n<=SEMOPS_MAX));
+  for (i = 0; i < n; i++)
+    if (((ops[i].op < 0) ? semDown (semgid, ops[i].sindex) : semUp (semgid, ops[i].sindex)) == -1)
+       return -1;
+  return 0;
+}
+
+/**
+ *  \brief Non-blocking <em>down</em> of a semaphore within the set.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is in <em>red state</em> (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semTryDown (int semgid, unsigned int sindex)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  if (sem_trywait (&set->sem[sindex]) == -1)
+     return -1;
+  if (semAccounting ()) semAccount (sindex, 0);
+  return 0;
+}
+
+/**
+ *  \brief <em>Down</em> of a semaphore within the set, waiting at most a given time.
+ *
+ *  The function fails if there is no semaphore set with an identifier equal to <tt>semgid</tt>, or if the
+ *  semaphore is still in <em>red state</em> when the time expires (<tt>errno</tt> is set to <tt>EAGAIN</tt>).
+ *  <tt>sem_timedwait</tt> measures the time on CLOCK_REALTIME.
+ *
+ *  \param semgid set identifier
+ *  \param sindex semaphore location in the set (1 .. snum)
+ *  \param timeout maximum waiting time (ms)
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int semDownTimed (int semgid, unsigned int sindex, unsigned int timeout)
+{
+  PSEM_SET *set;                                                                            /* mapping of the set */
+  struct timespec deadline;
+  unsigned long long t0 = 0;                                                              /* start of blocking (ns) */
+  int status;
+
+  assert(sindex>0);
+  if ((set = semAttachSet (semgid)) == NULL)
+     return -1;
+  if (sindex >= set->snum)
+     { errno = EFBIG;
+       return -1;
+     }
+  if (semAccounting ())
+     { if (semTryDown (semgid, sindex) == 0)                                          /* accounted for by semTryDown */
+          return 0;
+       if (errno != EAGAIN)
+          return -1;
+       t0 = semNowNs ();
+     }
+  clock_gettime (CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout / 1000;
+  deadline.tv_nsec += (timeout % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+     { deadline.tv_sec += 1;
+       deadline.tv_nsec -= 1000000000L;
+     }
+  if (blockedOn != NULL) *blockedOn = sindex;
+  while (((status = sem_timedwait (&set->sem[sindex], &deadline)) == -1) && (errno == EINTR));
+  if (blockedOn != NULL) *blockedOn = 0;
+  if ((status == 0) && semAccounting ()) semAccount (sindex, t0);
+  if ((status == -1) && (errno == ETIMEDOUT))
+     errno = EAGAIN;
+  return status;
+}
+
+/**
+ *  \brief Tracing of the semaphore the calling process is blocked on.
+ *
+ *  From now on, every <em>down</em> of the process stores the semaphore location in <tt>*p_where</tt> before it
+ *  may block and 0 after it completes, so that a watchdog can tell what a stalled process is waiting for.
+ *
+ *  \param p_where pointer to the location (usually in shared memory) that holds the semaphore location, or NULL
+ *         to stop tracing
+ */
+
+void semBlockedOn (unsigned int *p_where)
+{
+  blockedOn = p_where;
+}
@@ -17,55 +17,339 @@
 #ifndef SHAREDDATASYNC_H_
 #define SHAREDDATASYNC_H_
 
+#include <stddef.h>
+#include <sched.h>
+
 #include "probConst.h"
 #include "probDataStruct.h"
+#include "logging.h"
+#include "semaphore.h"
+
+/**
+ *  \brief Definition of the location of the semaphore a process is blocked on, alone in its cache line.
+ */
+typedef struct
+        { /** \brief semaphore location (0 if none) */
+          _Alignas(CACHE_LINE) unsigned int sindex;
+        } BLOCKED_SLOT;
+
+/**
+ *  \brief Definition of a slot of a request queue.
+ */
+typedef struct
+        { /** \brief position of the slot plus 1 when it holds the request of that position, position otherwise */
+          unsigned long long ticket;
+          /** \brief request */
+          request req;
+        } REQ_SLOT;
+
+/**
+ *  \brief Definition of a request queue (multiple producers, multiple consumers, lock free).
+ */
+typedef struct
+        { /** \brief number of slots (power of 2) */
+          unsigned int size;
+          /** \brief offset of the slots from the start of the shared region */
+          size_t slotOff;
+          /** \brief next position to be claimed by a producer */
+          _Alignas(CACHE_LINE) unsigned long long head;
+          /** \brief next position to be claimed by a consumer */
+          _Alignas(CACHE_LINE) unsigned long long tail;
+        } REQ_QUEUE;
 
 /**
  *  \brief Definition of <em>shared information</em> data type.
+ *
+ *  Blocks written by different processes, or written by some and only read by the others, start on cache lines
+ *  of their own: the full state, the logging control data, the ends of the request queues of the waiters and of
+ *  the order queue of the kitchen, the
+ *  semaphore ids (read on every semaphore operation), the slot of each process traced by the watchdog, the
+ *  contention statistics and the adaptive down counters.
+ *
+ *  The structure is the header of the shared region: the arrays whose size depends on the number of groups, tables,
+ *  waiters and chefs in config.txt follow it (see <tt>setSharedData</tt>), in the order of <tt>sharedDataSize</tt>, and
+ *  are located by their offsets from the start of the region.
  */
 typedef struct
         { /** \brief full state of the problem */
           FULL_STAT fSt;
 
+          /** \brief logging control data (format and record sequence number) */
+          LOG_CTL logCtl;
+
+          /** \brief queue of the requests of groups and chefs to waiters, one per zone of tables, in arrival order */
+          REQ_QUEUE waiterQueue[MAXWAITERS];
+          /** \brief number of requests taken out of the queues by the waiters */
+          _Alignas(CACHE_LINE) unsigned int waiterTaken;
+
+          /** \brief queue of the food orders of waiters to chefs (the kitchen), in arrival order */
+          REQ_QUEUE chefQueue;
+          /** \brief number of food orders taken out of the kitchen queue by the chefs */
+          _Alignas(CACHE_LINE) unsigned int chefTaken;
+
           /* semaphores ids */
           /** \brief identification of critical region protection semaphore – val = 1 */
-          unsigned int mutex;
+          _Alignas(CACHE_LINE) unsigned int mutex;
           /** \brief identification of semaphore used by receptionist to wait for groups - val = 0 */
           unsigned int receptionistReq;
           /** \brief identification of semaphore used by groups to wait before issuing receptionist request - val = 1 */
           unsigned int receptionistRequestPossible;
-          /** \brief identification of semaphore used by waiter to wait for requests – val = 0  */
+          /** \brief identification of semaphore used by waiters to wait for requests (number in their queues) – val = 0  */
           unsigned int waiterRequest;
-          /** \brief identification of semaphore used by groups and chef to wait before issuing waiter request - val = 1 */
-          unsigned int waiterRequestPossible;
-          /** \brief identification of semaphore used by chef to wait for order – val = 0  */
+          /** \brief identification of semaphore used by chefs to wait for orders (number in kitchen queue) – val = 0 */
           unsigned int waitOrder;
-          /** \brief identification of semaphore used by waiter to wait for chef – val = 0  */
-          unsigned int orderReceived;
-          /** \brief identification of semaphore used by groups to wait for table – val = 0 */
-          unsigned int waitForTable[MAXGROUPS];
-          /** \brief identification of semaphore used by groups to wait for waiter ackowledge – val = 0  */
-          unsigned int requestReceived[NUMTABLES];
-          /** \brief identification of semaphore used by groups to wait for food – val = 0 */
-          unsigned int foodArrived[NUMTABLES];
-          /** \brief identification of semaphore used by groups to wait for payment completed – val = 0 */
-          unsigned int tableDone[NUMTABLES];
+          /** \brief identification of semaphore used by the main process to wait for the end of the entities – val = 0 */
+          unsigned int rolesDone;
+
+          /* watchdog data */
+          /** \brief watchdog deadline in seconds (0 if there is no watchdog) */
+          unsigned int watchdog;
+          /** \brief offset of the semaphore each group is blocked on (0 if none, only traced with a watchdog) */
+          size_t groupBlockedOnOff;
+          /** \brief semaphore each waiter is blocked on (0 if none, only traced with a watchdog) */
+          BLOCKED_SLOT waiterBlockedOn[MAXWAITERS];
+          /** \brief semaphore each chef is blocked on (0 if none, only traced with a watchdog) */
+          BLOCKED_SLOT chefBlockedOn[MAXCHEFS];
+          /** \brief semaphore the receptionist is blocked on (0 if none, only traced with a watchdog) */
+          BLOCKED_SLOT receptionistBlockedOn;
+
+          /* contention statistics */
+          /** \brief non-zero if the processes record the contention statistics of the semaphores */
+          _Alignas(CACHE_LINE) unsigned int semStatsOn;
+          /** \brief offset of the contention statistics of each semaphore, indexed by semaphore location */
+          size_t semStatOff;
+
+          /* adaptive down counters */
+          /** \brief number of adaptive downs on the mutex completed at the first poll (all processes) */
+          _Alignas(CACHE_LINE) unsigned long mutexFast;
+          /** \brief number of adaptive downs on the mutex completed while spinning (all processes) */
+          unsigned long mutexSpun;
+          /** \brief number of adaptive downs on the mutex that had to block (all processes) */
+          unsigned long mutexBlocked;
 
         } SHARED_DATA;
 
-/** \brief number of semaphores in the set */
-#define SEM_NU               ( 7 + sh->fSt.nGroups + 3*NUMTABLES )
+_Static_assert ((offsetof (SHARED_DATA, fSt.receptionistRequest) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, waiterQueue[0].head) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, waiterQueue[0].tail) % CACHE_LINE == 0) &&
+                (sizeof (REQ_QUEUE) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, waiterTaken) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, chefQueue.head) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, chefQueue.tail) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, chefTaken) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, fSt.nGroups) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, logCtl) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, logCtl.seq) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, logCtl.ring.head) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, logCtl.ring.tail) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, mutex) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, waiterBlockedOn) % CACHE_LINE == 0) &&
+                (sizeof (BLOCKED_SLOT) == CACHE_LINE) &&
+                (offsetof (SHARED_DATA, semStatsOn) % CACHE_LINE == 0) &&
+                (offsetof (SHARED_DATA, mutexFast) % CACHE_LINE == 0) &&
+                (sizeof (SHARED_DATA) % CACHE_LINE == 0),
+                "SHARED_DATA: blocks written by different processes must not share cache lines");
 
 #define MUTEX                  1
 #define RECEPTIONISTREQ        2
 #define RECEPTIONISTREQUESTPOSSIBLE  3
 #define WAITERREQUEST          4
-#define WAITERREQUESTPOSSIBLE  5
-#define WAITORDER              6
-#define ORDERRECEIVED          7
-#define WAITFORTABLE           8
-#define FOODARRIVED            (WAITFORTABLE+sh->fSt.nGroups)
-#define REQUESTRECEIVED        (FOODARRIVED+NUMTABLES)
-#define TABLEDONE              (REQUESTRECEIVED+NUMTABLES)
+#define WAITORDER              5
+#define ROLESDONE              6
+
+/**
+ *  \brief first semaphore of the tables (the first multiple of SEMSET_ALIGN after the ones above).
+ *
+ *  The semaphores of each table take SEMSET_ALIGN locations (foodArrived, requestReceived, tableDone and an unused
+ *  one), so that they stay in the same SysV set when the semaphore set is split; the semaphores of the groups
+ *  follow them.
+ */
+#define TABLESEMS              8
+
+/** \brief number of semaphores in the set */
+static inline unsigned int semNu (SHARED_DATA *sh)
+{
+  return TABLESEMS - 1 + SEMSET_ALIGN * sh->fSt.nTables + sh->fSt.nGroups;
+}
+
+/** \brief identification of semaphore used by the group at table t to wait for food – val = 0 */
+static inline unsigned int foodArrived (SHARED_DATA *sh, int t)
+{
+  return TABLESEMS + SEMSET_ALIGN * t;
+}
+
+/** \brief identification of semaphore used by the group at table t to wait for waiter acknowledge – val = 0 */
+static inline unsigned int requestReceived (SHARED_DATA *sh, int t)
+{
+  return foodArrived (sh, t) + 1;
+}
+
+/** \brief identification of semaphore used by the group at table t to wait for payment completed – val = 0 */
+static inline unsigned int tableDone (SHARED_DATA *sh, int t)
+{
+  return foodArrived (sh, t) + 2;
+}
+
+/** \brief identification of semaphore used by group g to wait for table – val = 0 */
+static inline unsigned int waitForTable (SHARED_DATA *sh, int g)
+{
+  return foodArrived (sh, sh->fSt.nTables) + g;
+}
+
+/** \brief semaphore each group is blocked on */
+static inline BLOCKED_SLOT *groupBlockedOn (SHARED_DATA *sh)
+{
+  return (BLOCKED_SLOT *) ((char *) sh + sh->groupBlockedOnOff);
+}
+
+/** \brief contention statistics of each semaphore (semNu + 1 entries, indexed by semaphore location) */
+static inline SEMSTAT *semStat (SHARED_DATA *sh)
+{
+  return (SEMSTAT *) ((char *) sh + sh->semStatOff);
+}
+
+/**
+ *  \brief number of slots of each request queue of the waiters, and of the order queue of the kitchen, for nTables
+ *  tables.
+ *
+ *  Each group at a table has at most one request in the queues of the waiters (its food request, or the food ready
+ *  request of a chef once a waiter took its order) and at most one order in the kitchen, so a queue never fills up.
+ */
+static inline unsigned int requestQueueSize (int nTables)
+{
+  unsigned int size = 1;
+
+  while (size < (unsigned int) nTables + 1)
+    size <<= 1;
+  return size;
+}
+
+/**
+ *  \brief request queue of the zone of table t.
+ *
+ *  The tables are dealt out to the waiters in turn: waiter w looks after the tables t with t % nWaiters == w, and
+ *  takes the requests of their groups first.
+ */
+static inline REQ_QUEUE *waiterZone (SHARED_DATA *sh, int t)
+{
+  return &sh->waiterQueue[t % sh->fSt.nWaiters];
+}
+
+/** \brief slot of position pos of a request queue */
+static inline REQ_SLOT *queueSlot (SHARED_DATA *sh, REQ_QUEUE *p_q, unsigned long long pos)
+{
+  return (REQ_SLOT *) ((char *) sh + p_q->slotOff) + (pos & (p_q->size - 1));
+}
+
+/** \brief empties a request queue of nTables tables whose slots are at offset off; returns the size of the slots */
+static inline size_t setRequestQueue (SHARED_DATA *sh, REQ_QUEUE *p_q, int nTables, size_t off)
+{
+  unsigned int pos;
+
+  p_q->size = requestQueueSize (nTables);
+  p_q->slotOff = off;
+  p_q->head = p_q->tail = 0;
+  for (pos = 0; pos < p_q->size; pos++)
+    queueSlot (sh, p_q, pos)->ticket = pos;
+  return CACHE_ROUND (p_q->size * sizeof (REQ_SLOT));
+}
+
+/**
+ *  \brief posts a request on a request queue (any number of producers).
+ *
+ *  As with the log ring buffer, a producer claims the head position with a compare and swap once the slot of that
+ *  position is free, fills the slot and publishes it by advancing its ticket. The consumer must be told about the
+ *  request with an <em>up</em> of the semaphore it waits on.
+ */
+static inline void postRequest (SHARED_DATA *sh, REQ_QUEUE *p_q, int reqType, int reqGroup)
+{
+  unsigned long long pos = __atomic_load_n (&p_q->head, __ATOMIC_RELAXED), ticket;
+  REQ_SLOT *slot;
+
+  for (;;)
+  { slot = queueSlot (sh, p_q, pos);
+    ticket = __atomic_load_n (&slot->ticket, __ATOMIC_ACQUIRE);
+    if ((ticket == pos) &&
+        __atomic_compare_exchange_n (&p_q->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+       break;
+    if (ticket < pos)                                                                          /* queue is full */
+       sched_yield ();
+    pos = __atomic_load_n (&p_q->head, __ATOMIC_RELAXED);
+  }
+  slot->req.reqType = reqType;
+  slot->req.reqGroup = reqGroup;
+  __atomic_store_n (&slot->ticket, pos + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief takes the oldest request out of a request queue (any number of consumers).
+ *
+ *  A consumer claims the tail position with a compare and swap once the slot of that position holds its request,
+ *  reads it and frees the slot for the producers of the next round.
+ *  If the oldest request is not published yet, the queue is taken as empty: the <em>down</em> of the semaphore the
+ *  consumers wait on only tells there is a request in some queue, and the caller looks for it in the others.
+ *
+ *  \return true, if a request was taken; false, if the queue is empty
+ */
+static inline bool takeRequest (SHARED_DATA *sh, REQ_QUEUE *p_q, request *p_req)
+{
+  unsigned long long pos = __atomic_load_n (&p_q->tail, __ATOMIC_RELAXED), ticket;
+  REQ_SLOT *slot;
+
+  for (;;)
+  { slot = queueSlot (sh, p_q, pos);
+    ticket = __atomic_load_n (&slot->ticket, __ATOMIC_ACQUIRE);
+    if (ticket < pos + 1)                                                                     /* queue is empty */
+       return false;
+    if ((ticket == pos + 1) &&
+        __atomic_compare_exchange_n (&p_q->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+       break;
+    pos = __atomic_load_n (&p_q->tail, __ATOMIC_RELAXED);
+  }
+  *p_req = slot->req;
+  __atomic_store_n (&slot->ticket, pos + p_q->size, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ *  \brief size of the shared region for nGroups groups, nTables tables and nWaiters waiters (bytes).
+ *
+ *  The header is followed by the arrays of the full state, the slot of each group traced by the watchdog, the
+ *  contention statistics of each semaphore, the slots of the request queue of each waiter and of the order queue of
+ *  the kitchen (shared by all the chefs), and the data of the logging control data (with room for the slots of the
+ *  log ring buffer if <tt>ring</tt> is set), each block on cache lines of its own.
+ */
+static inline size_t sharedDataSize (int nGroups, int nTables, int nWaiters, bool ring)
+{
+  return sizeof (SHARED_DATA) + fullStatDataSize (nGroups) + nGroups * sizeof (BLOCKED_SLOT)
+         + CACHE_ROUND ((TABLESEMS + nGroups + SEMSET_ALIGN * (size_t) nTables) * sizeof (SEMSTAT))
+         + (nWaiters + 1) * CACHE_ROUND (requestQueueSize (nTables) * sizeof (REQ_SLOT))
+         + logCtlDataSize (nGroups, ring);
+}
+
+/**
+ *  \brief locates the arrays of the shared region of sharedDataSize bytes at sh, sets the number of groups,
+ *  tables, waiters and chefs, and empties the request queues of the waiters and the order queue of the kitchen.
+ */
+static inline void setSharedData (SHARED_DATA *sh, int nGroups, int nTables, int nWaiters, int nChefs, bool ring)
+{
+  size_t off = sizeof (SHARED_DATA);                                                         /* offset of next block */
+  int w;
+
+  setFullStatData (&sh->fSt, (char *) sh + off, nGroups);
+  sh->fSt.nTables = nTables;
+  sh->fSt.nWaiters = nWaiters;
+  sh->fSt.nChefs = nChefs;
+  off += fullStatDataSize (nGroups);
+  sh->groupBlockedOnOff = off;
+  off += nGroups * sizeof (BLOCKED_SLOT);
+  sh->semStatOff = off;
+  off += CACHE_ROUND ((semNu (sh) + 1) * sizeof (SEMSTAT));
+  for (w = 0; w < nWaiters; w++)
+    off += setRequestQueue (sh, &sh->waiterQueue[w], nTables, off);
+  off += setRequestQueue (sh, &sh->chefQueue, nTables, off);
+  sh->waiterTaken = sh->chefTaken = 0;
+  setLogCtlData (&sh->logCtl, (char *) sh + off, nGroups, ring);
+}
 
 #endif /* SHAREDDATASYNC_H_ */
@@ -0,0 +1,282 @@
+/**
+ *  \file sharedMemoryPosix.c (implementation file)
+ *
+ *  \brief Shared memory management (POSIX backend).
+ *
+ *   Operations defined on shared memory:
+ *      \li creation of a new block
+ *      \li connection to a previously created block
+ *      \li destruction of a previously created block
+ *      \li mapping of the block previously created on the process address space
+ *      \li unmapping of the block off the process address space.
+ *
+ *  Drop-in replacement of sharedMemory.c (same interface, sharedMemory.h), selected at build time with
+ *  <tt>make pshm</tt>. The block is a POSIX shared memory object (<tt>shm_open</tt>, named after the creation
+ *  key: <tt>/restaurant_<key></tt>) mapped with <tt>mmap</tt>; the block identifier is its file descriptor.
+ *
+ *  Build options (<tt>SHMOPTS</tt> in the Makefile):
+ *      \li <tt>PSHM_POPULATE</tt>: prefault the whole block for writing when it is mapped
+ *          (<tt>madvise (MADV_POPULATE_WRITE)</tt>, or touching each page on kernels older than 5.14), so that no
+ *          process takes first-touch page faults while the simulation runs
+ *      \li <tt>PSHM_THP</tt>: ask for transparent huge pages (<tt>madvise (MADV_HUGEPAGE)</tt>, before the block
+ *          is prefaulted; effective when <tt>/sys/kernel/mm/transparent_hugepage/shmem_enabled</tt> is
+ *          <tt>advise</tt> or <tt>always</tt>; ignored with <tt>PSHM_HUGETLB</tt>, whose pages are huge already)
+ *      \li <tt>PSHM_HUGETLB</tt>: back the block with a file of the hugetlbfs mounted on <tt>PSHM_HUGETLB_DIR</tt>
+ *          (<tt>/dev/hugepages</tt> by default), its size rounded up to <tt>PSHM_HUGEPAGE</tt>; huge pages must
+ *          have been reserved (<tt>/proc/sys/vm/nr_hugepages</tt>).
+ */
+
+#define _GNU_SOURCE                                                        /* MADV_HUGEPAGE, MADV_POPULATE_WRITE */
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/** \brief access permission: user r-w */
+#define  MASK           0600
+
+/** \brief maximum number of blocks a process can be connected to */
+#define  MAXBLOCKS      4
+
+#ifdef PSHM_HUGETLB
+#ifndef PSHM_HUGETLB_DIR
+/** \brief mount point of the hugetlbfs */
+#define  PSHM_HUGETLB_DIR "/dev/hugepages"
+#endif
+/** \brief huge page size (bytes) */
+#define  PSHM_HUGEPAGE   (2UL * 1024 * 1024)
+#endif
+
+/** \brief blocks the process is connected to: identifier, name, size and mapping address */
+static struct {
+    int shmid;
+    char name[64];
+    size_t size;
+    void *addr;
+} conn[MAXBLOCKS];
+
+/** \brief number of blocks the process is connected to */
+static int nConn = 0;
+
+/* internal functions */
+
+/** \brief name of the block with creation key key */
+static void blockName (int key, char *name)
+{
+#ifdef PSHM_HUGETLB
+  sprintf (name, "%s/restaurant_%08x", PSHM_HUGETLB_DIR, (unsigned int) key);
+#else
+  sprintf (name, "/restaurant_%08x", (unsigned int) key);
+#endif
+}
+
+/** \brief opens the block with creation key key; returns its file descriptor, or -1 on error */
+static int openBlock (int key, int flags, char *name)
+{
+  blockName (key, name);
+#ifdef PSHM_HUGETLB
+  return open (name, flags, MASK);
+#else
+  return shm_open (name, flags, MASK);
+#endif
+}
+
+/** \brief registers a block the process is connected to; returns its identifier, or -1 on error */
+static int addBlock (int fd, char *name, size_t size)
+{
+  int n;
+
+  if (nConn == MAXBLOCKS)
+     { close (fd);
+       errno = ENOMEM;
+       return -1;
+     }
+  n = nConn++;
+  conn[n].shmid = fd;
+  snprintf (conn[n].name, sizeof (conn[n].name), "%s", name);
+  conn[n].size = size;
+  conn[n].addr = NULL;
+  return fd;
+}
+
+/** \brief entry of the block with identifier shmid, or with mapping address addr if shmid is -1; -1 if none */
+static int findBlock (int shmid, void *addr)
+{
+  int n;
+
+  for (n = 0; n < nConn; n++)
+    if ((shmid != -1) ? (conn[n].shmid == shmid) : (conn[n].addr == addr))
+       return n;
+  errno = EINVAL;
+  return -1;
+}
+
+/**
+ *  \brief Creation of a new block.
+ *
+ *  The function fails if there is already a block of shared memory with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *  \param size block size (in bytes)
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemCreate (int key, unsigned int size)
+{
+  char name[64];                                                                                 /* block name */
+  size_t bsize = size;                                                                      /* actual block size */
+  int fd;                                                                                  /* block descriptor */
+
+#ifdef PSHM_HUGETLB
+  bsize = (bsize + PSHM_HUGEPAGE - 1) & ~(PSHM_HUGEPAGE - 1);
+#endif
+  if ((fd = openBlock (key, O_RDWR | O_CREAT | O_EXCL, name)) == -1)
+     return -1;
+  if (ftruncate (fd, (off_t) bsize) == -1)
+     { close (fd);
+       unlink (name);
+       return -1;
+     }
+  return addBlock (fd, name, bsize);
+}
+
+/**
+ *  \brief Connection to a previously created block.
+ *
+ *  The function fails if there is no block with a creation key equal to <tt>key</tt>.
+ *
+ *  \param key creation key
+ *
+ *  \return block identifier, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemConnect (int key)
+{
+  char name[64];                                                                                 /* block name */
+  struct stat st;                                                                           /* block attributes */
+  int fd;                                                                                  /* block descriptor */
+
+  if ((fd = openBlock (key, O_RDWR, name)) == -1)
+     return -1;
+  if (fstat (fd, &st) == -1)
+     { close (fd);
+       return -1;
+     }
+  return addBlock (fd, name, (size_t) st.st_size);
+}
+
+/**
+ *  \brief Destruction of a previously created block.
+ *
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemDestroy (int shmid)
+{
+  int n, status;
+
+  if ((n = findBlock (shmid, NULL)) == -1)
+     return -1;
+#ifdef PSHM_HUGETLB
+  status = unlink (conn[n].name);
+#else
+  status = shm_unlink (conn[n].name);
+#endif
+  if (conn[n].addr != NULL)
+     munmap (conn[n].addr, conn[n].size);
+  close (conn[n].shmid);
+  conn[n] = conn[--nConn];
+  return status;
+}
+
+#ifdef PSHM_POPULATE
+/** \brief prefaults the pages of a mapping for writing, leaving its contents unchanged */
+static int populate (void *add, size_t size)
+{
+  size_t page = (size_t) sysconf (_SC_PAGESIZE), off;
+
+#ifdef MADV_POPULATE_WRITE
+  if (madvise (add, size, MADV_POPULATE_WRITE) == 0)
+     return 0;
+  if (errno != EINVAL)                                                       /* EINVAL: kernel older than 5.14 */
+     return -1;
+#endif
+  for (off = 0; off < size; off += page)
+    __atomic_fetch_add ((char *) add + off, 0, __ATOMIC_RELAXED);
+  return 0;
+}
+#endif
+
+/**
+ *  \brief Mapping of the block previously created on the process address space.
+ *
+ *  The function fails if there is no block with an identifier equal to <tt>shmid</tt>.
+ *
+ *  \param shmid block identifier
+ *  \param pAttAdd pointer to the location where the local address of the attached block is stored
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemAttach (int shmid, void **pAttAdd)
+{
+  void *add;                                                                                    /* temporary pointer */
+  int n;
+
+  if ((n = findBlock (shmid, NULL)) == -1)
+     return -1;
+  if ((add = mmap (NULL, conn[n].size, PROT_READ | PROT_WRITE, MAP_SHARED, conn[n].shmid, 0)) == MAP_FAILED)
+     return -1;
+#if defined (PSHM_THP) && !defined (PSHM_HUGETLB)
+  if (madvise (add, conn[n].size, MADV_HUGEPAGE) == -1)                       /* before the pages are faulted in */
+     { munmap (add, conn[n].size);
+       return -1;
+     }
+#endif
+#ifdef PSHM_POPULATE
+  if (populate (add, conn[n].size) == -1)
+     { munmap (add, conn[n].size);
+       return -1;
+     }
+#endif
+  conn[n].addr = add;
+  *pAttAdd = add;
+  return 0;
+}
+
+/**
+ *  \brief Unmapping of the block off the process address space.
+ *
+ *  The function fails if the pointer does not locate a region of the address space
+ *  where a mapping took previously place.
+ *
+ *  \param attAdd local address of the attached block
+ *
+ *  \return \c 0, upon success
+ *  \return -\c 1, when an error occurs (the actual situation is reported in <tt>errno</tt>)
+ */
+
+int shmemDettach (void *attAdd)
+{
+  int n;
+
+  if ((n = findBlock (-1, attAdd)) == -1)
+     return -1;
+  if (munmap (attAdd, conn[n].size) == -1)
+     return -1;
+  conn[n].addr = NULL;
+  return 0;
+}